@@ -0,0 +1,106 @@
+#ifndef ADDRESS_MAP_HPP
+#define ADDRESS_MAP_HPP
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <stdexcept>
+#include <cstdint>
+#include "config.hpp"
+#include "channels/AXICommon.hpp"
+
+// Spreads the bus address space over the bus.slaves memory channels and
+// gives each channel its own dense address space (bus.interleave):
+//   range  one bus.address_map window per slave, the local address is the
+//          offset into it
+//   line   consecutive bus.line_bytes blocks go round the channels
+//   page   the same with 4KB blocks
+//   xor    4KB blocks, the channel is the block number's low bits XORed
+//          with every higher group of as many bits, so power-of-two strides
+//          still reach every channel; needs a power-of-two channel count
+// Outside range mode the local address drops the channel out of the block
+// number, so a channel sees one contiguous range and its DRAM banks stay
+// evenly used.
+class AddressMap {
+public:
+    enum mode { RANGE, LINE, PAGE, XOR };
+
+    explicit AddressMap (const config& cfg)
+        : channels(cfg.bus.slaves ? cfg.bus.slaves : 1)
+        , windows(cfg.bus.address_map)
+    {
+        const std::string& name = cfg.bus.interleave;
+        if (name == "range") {
+            kind = RANGE;
+        } else if (name == "line") {
+            kind = LINE;
+            block_bytes = cfg.bus.line_bytes;
+        } else if (name == "page") {
+            kind = PAGE;
+        } else if (name == "xor") {
+            kind = XOR;
+        } else {
+            throw std::invalid_argument("unknown bus.interleave '" + name + "'");
+        }
+        if (block_bytes < BEAT_BYTES || block_bytes > 4096 || (block_bytes & (block_bytes - 1))) {
+            throw std::invalid_argument("bus.line_bytes must be a power of two from one beat to 4KB");
+        }
+        if (kind == XOR && (channels & (channels - 1))) {
+            throw std::invalid_argument("bus.interleave: xor needs a power-of-two bus.slaves");
+        }
+        if (kind == RANGE && windows.size() < channels) {
+            throw std::invalid_argument("bus.address_map has fewer windows than bus.slaves");
+        }
+        while ((1u << channel_bits) < channels) {
+            channel_bits++;
+        }
+    }
+
+    mode interleave () const {
+        return kind;
+    }
+
+    // bytes of address that stay on one channel, 0 for range mode
+    uint64_t block () const {
+        return kind == RANGE ? 0 : block_bytes;
+    }
+
+    // channel of addr and the address within it; -1 when no channel has it
+    int decode (uint64_t addr, uint64_t& local) const {
+        if (kind == RANGE) {
+            for (size_t s = 0; s < windows.size() && s < channels; s++) {
+                if (addr >= windows[s].first && addr - windows[s].first < windows[s].second) {
+                    local = addr - windows[s].first;
+                    return static_cast<int>(s);
+                }
+            }
+            return -1;
+        }
+        uint64_t number = addr / block_bytes;
+        uint64_t offset = addr % block_bytes;
+        uint64_t channel;
+        uint64_t rest;
+        if (kind == XOR && channel_bits > 0) {
+            rest = number >> channel_bits;
+            channel = number;
+            for (uint64_t high = rest; high; high >>= channel_bits) {
+                channel ^= high;
+            }
+            channel &= channels - 1;
+        } else {
+            rest = number / channels;
+            channel = number % channels;
+        }
+        local = rest * block_bytes + offset;
+        return static_cast<int>(channel);
+    }
+
+private:
+    uint32_t channels;
+    std::vector<std::pair<uint64_t, uint64_t>> windows; // {base, size} per slave
+    mode kind = RANGE;
+    uint64_t block_bytes = 4096;
+    uint32_t channel_bits = 0;
+};
+
+#endif
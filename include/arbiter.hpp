@@ -0,0 +1,98 @@
+#ifndef ARBITER_HPP
+#define ARBITER_HPP
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <stdexcept>
+
+// Picks one requester out of a request vector. pick() is only called when
+// at least one entry is set and returns the granted index.
+class Arbiter {
+public:
+    virtual ~Arbiter() {}
+    virtual int pick (const std::vector<bool>& req) = 0;
+
+    static std::unique_ptr<Arbiter> create (const std::string& policy, const std::vector<uint32_t>& weights);
+};
+
+// lowest index wins
+class FixedPriorityArbiter : public Arbiter {
+public:
+    int pick (const std::vector<bool>& req) override {
+        for (size_t i = 0; i < req.size(); i++) {
+            if (req[i]) {
+                return i;
+            }
+        }
+        return -1;
+    }
+};
+
+// search starts one past the last grant
+class RoundRobinArbiter : public Arbiter {
+public:
+    int pick (const std::vector<bool>& req) override {
+        size_t n = req.size();
+        for (size_t k = 0; k < n; k++) {
+            size_t i = (next + k) % n;
+            if (req[i]) {
+                next = i + 1;
+                return i;
+            }
+        }
+        return -1;
+    }
+
+private:
+    size_t next = 0;
+};
+
+// weighted round-robin: requester i may take weights[i] consecutive grants
+// before the pointer moves on
+class WeightedArbiter : public Arbiter {
+public:
+    explicit WeightedArbiter (const std::vector<uint32_t>& weights) : weights(weights) {}
+
+    int pick (const std::vector<bool>& req) override {
+        size_t n = req.size();
+        if (req[curr] && credit < weight(curr)) {
+            credit++;
+            return curr;
+        }
+        for (size_t k = 1; k <= n; k++) {
+            size_t i = (curr + k) % n;
+            if (req[i]) {
+                curr = i;
+                credit = 1;
+                return i;
+            }
+        }
+        return -1;
+    }
+
+private:
+    std::vector<uint32_t> weights;
+    size_t curr = 0;
+    uint32_t credit = 0;
+
+    uint32_t weight (size_t i) const {
+        return (i < weights.size() && weights[i] > 0) ? weights[i] : 1;
+    }
+};
+
+inline std::unique_ptr<Arbiter> Arbiter::create (const std::string& policy, const std::vector<uint32_t>& weights) {
+    if (policy == "round_robin") {
+        return std::unique_ptr<Arbiter>(new RoundRobinArbiter());
+    }
+    if (policy == "fixed_priority") {
+        return std::unique_ptr<Arbiter>(new FixedPriorityArbiter());
+    }
+    if (policy == "weighted") {
+        return std::unique_ptr<Arbiter>(new WeightedArbiter(weights));
+    }
+    throw std::invalid_argument("unknown arbiter policy: " + policy);
+}
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef ASYNC_WRITER_HPP
+#define ASYNC_WRITER_HPP
+
+#include <string>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+#include <cstdio>
+#include <zlib.h>
+
+// Moves file output off the simulation thread. Producers hand over whole
+// chunks with write(); a writer thread drains them to disk, gzip-compressed
+// when requested. At most MAX_QUEUED chunks wait at a time, after which
+// write() blocks, so a slow disk bounds memory rather than growing it.
+class AsyncWriter {
+public:
+    AsyncWriter (const std::string& path, bool compress) : path(path) {
+        if (compress) {
+            gz = gzopen(path.c_str(), "wb6");
+        } else {
+            file = std::fopen(path.c_str(), "wb");
+        }
+        if (!gz && !file) {
+            throw std::runtime_error("cannot create output file: " + path);
+        }
+        worker = std::thread(&AsyncWriter::run, this);
+    }
+
+    AsyncWriter (const AsyncWriter&) = delete;
+    AsyncWriter& operator= (const AsyncWriter&) = delete;
+
+    ~AsyncWriter () {
+        close();
+    }
+
+    void write (std::string&& chunk) {
+        if (chunk.empty()) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        space.wait(lock, [this] { return done || queue.size() < MAX_QUEUED; });
+        if (done) {
+            return;
+        }
+        queue.push_back(std::move(chunk));
+        ready.notify_one();
+    }
+
+    // flush everything queued and close the file; later writes are dropped
+    void close () {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (done) {
+                return;
+            }
+            done = true;
+        }
+        ready.notify_one();
+        space.notify_all();
+        worker.join();
+        if (gz) {
+            gzclose(gz);
+        }
+        if (file) {
+            std::fclose(file);
+        }
+    }
+
+private:
+    static constexpr size_t MAX_QUEUED = 16;
+
+    std::string path;
+    gzFile gz = nullptr;
+    FILE* file = nullptr;
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::condition_variable space;
+    std::deque<std::string> queue;
+    bool done = false;
+
+    void run () {
+        while (true) {
+            std::string chunk;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                ready.wait(lock, [this] { return done || !queue.empty(); });
+                if (queue.empty()) {
+                    return;
+                }
+                chunk = std::move(queue.front());
+                queue.pop_front();
+            }
+            space.notify_one();
+            if (gz) {
+                gzwrite(gz, chunk.data(), static_cast<unsigned>(chunk.size()));
+            } else {
+                std::fwrite(chunk.data(), 1, chunk.size(), file);
+            }
+        }
+    }
+};
+
+#endif
@@ -2,20 +2,448 @@
 #define BUS_HPP
 
 #include <systemc>
+#include <tlm>
+#include <tlm_utils/multi_passthrough_target_socket.h>
+#include <tlm_utils/multi_passthrough_initiator_socket.h>
+#include <tlm_utils/peq_with_cb_and_phase.h>
 #include <string>
 #include <iostream>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstring>
+#include "arbiter.hpp"
+#include "address_map.hpp"
+#include "config.hpp"
+#include "channels/AXIPayload.hpp"
 
 using namespace sc_core;
 using namespace sc_dt;
 
+// Where a transaction came from and where it went, kept on the payload so
+// the response can be routed back and the master sees its own id/address.
+// A burst split over channels keeps its parts and how many of them still
+// owe END_REQ / BEGIN_RESP; each part points back to it and knows which
+// beats of the master's buffer it carries.
+struct BusRoute : tlm::tlm_extension<BusRoute> {
+    int master = -1;
+    int slave = -1;
+    uint32_t id = 0;
+    uint64_t addr = 0;
+    sc_time arrival;
+    std::vector<tlm::tlm_generic_payload*> parts;
+    uint32_t reqs_left = 0;
+    uint32_t resps_left = 0;
+    tlm::tlm_generic_payload* parent = nullptr;
+    std::vector<uint32_t> beats; // of a part: the parent's beat for each of its own
+
+    tlm::tlm_extension_base* clone() const override {
+        return new BusRoute(*this);
+    }
+
+    void copy_from(const tlm::tlm_extension_base& ext) override {
+        *this = static_cast<const BusRoute&>(ext);
+    }
+};
+
+// N x M AXI crossbar for the approximately-timed models. Masters bind to
+// rd_target_socket/wr_target_socket, slaves to rd_init_socket/wr_init_socket,
+// in index order.
+//
+//   AR/AW: per slave and direction an arbiter grants one master at a time;
+//          the address channel stays busy until the slave's END_REQ.
+//   R/B:   responses go back to the master recorded in the payload's
+//          BusRoute extension, one burst at a time per master, in arrival
+//          order.
+//
+// Slave-side ids are (master << ID_SHIFT) | id so that ids from different
+// masters stay distinct at the slave; the master's own ids must fit in
+// ID_SHIFT bits.
+//
+// Slaves are found through an AddressMap (bus.interleave). When it
+// interleaves, a burst whose beats leave one channel's block is cut into
+// one burst per channel, from the bus's own payload pool.
+// The parts are arbitrated at their slaves independently; the master sees
+// END_REQ once every part is accepted and one response once every part has
+// answered, read data gathered back into its buffer.
+//
+// The bus holds a reference to each master payload from BEGIN_REQ until it
+// has handled the END_RESP, so the master may release and reuse it as soon
+// as it sends END_RESP.
 SC_MODULE (Bus) {
+    static constexpr uint32_t ID_SHIFT = 24;
+    static constexpr uint32_t ID_MASK = (1u << ID_SHIFT) - 1;
+
+    tlm_utils::multi_passthrough_target_socket<Bus> rd_target_socket;
+    tlm_utils::multi_passthrough_target_socket<Bus> wr_target_socket;
+    tlm_utils::multi_passthrough_initiator_socket<Bus> rd_init_socket;
+    tlm_utils::multi_passthrough_initiator_socket<Bus> wr_init_socket;
+
+    SC_HAS_PROCESS(Bus);
+    Bus(sc_module_name name, const config& cfg)
+        : sc_module(name)
+        , rd_target_socket("rd_target_socket")
+        , wr_target_socket("wr_target_socket")
+        , rd_init_socket("rd_init_socket")
+        , wr_init_socket("wr_init_socket")
+        , hop_delay(cfg.bus.latency_cycles * cfg.clock.period_ns, SC_NS)
+        , policy(cfg.bus.arbiter)
+        , weights(cfg.bus.weights)
+        , interleave(cfg.bus.interleave)
+        , map(cfg)
+        , peq(this, &Bus::peq_cb)
+    {
+        rd_target_socket.register_nb_transport_fw(this, &Bus::nb_transport_fw);
+        wr_target_socket.register_nb_transport_fw(this, &Bus::nb_transport_fw);
+        rd_init_socket.register_nb_transport_bw(this, &Bus::nb_transport_bw);
+        wr_init_socket.register_nb_transport_bw(this, &Bus::nb_transport_bw);
+    }
+
+    // per slave: arbitration, then the slave's share of the bytes moved;
+    // load_imbalance is the busiest slave's bytes over the mean, 1 = even
+    void report (std::ostream& os, double exe_time) const {
+        uint64_t total = 0;
+        uint64_t most = 0;
+        for (size_t s = 0; s < ar.size(); s++) {
+            total += ar[s].bytes + aw[s].bytes;
+            most = std::max(most, ar[s].bytes + aw[s].bytes);
+        }
+        for (size_t s = 0; s < ar.size(); s++) {
+            report_channel(os, "AR", s, ar[s], exe_time);
+            report_channel(os, "AW", s, aw[s], exe_time);
+            uint64_t bytes = ar[s].bytes + aw[s].bytes;
+            os << "[Bus][slave:" << s << "] bytes: " << bytes
+               << ", share: " << (total ? double(bytes) / total : 0) << std::endl;
+        }
+        os << "[Bus] interleave: " << interleave
+           << ", split_bursts: " << split_bursts
+           << ", parts: " << split_parts
+           << ", load_imbalance: " << (total ? double(most) * ar.size() / total : 0) << std::endl;
+    }
+
+private:
+    // AR or AW side of one slave port
+    struct addr_channel {
+        std::vector<std::deque<tlm::tlm_generic_payload*>> waiting; // indexed by master
+        std::unique_ptr<Arbiter> arbiter;
+        bool busy = false;
+        uint64_t grants = 0;
+        uint64_t bytes = 0;
+        uint64_t contended = 0; // grants made while another master waited
+        double wait_ns = 0;     // BEGIN_REQ arrival -> forwarded to slave
+        sc_time busy_since;
+        double busy_ns = 0;
+    };
+
+    // R or B side of one master port
+    struct resp_channel {
+        std::deque<tlm::tlm_generic_payload*> waiting;
+        tlm::tlm_generic_payload* active = nullptr;
+    };
 
-    sc_core::sc_
+    sc_time hop_delay;
+    std::string policy;
+    std::vector<uint32_t> weights;
+    std::string interleave;
+    AddressMap map;
+    AXIPayloadPool part_pool;
+    uint64_t split_bursts = 0;
+    uint64_t split_parts = 0;
+
+    std::vector<addr_channel> ar;
+    std::vector<addr_channel> aw;
+    std::vector<resp_channel> r;
+    std::vector<resp_channel> b;
+
+    tlm_utils::peq_with_cb_and_phase<Bus> peq;
+
+    void end_of_elaboration () override {
+        size_t masters = rd_target_socket.size();
+        size_t slaves = rd_init_socket.size();
+        if (wr_target_socket.size() != masters || wr_init_socket.size() != slaves) {
+            SC_REPORT_ERROR("Bus", "socket bindings do not match bus.masters/bus.slaves");
+        }
+
+        ar.resize(slaves);
+        aw.resize(slaves);
+        for (size_t s = 0; s < slaves; s++) {
+            for (addr_channel* ch : { &ar[s], &aw[s] }) {
+                ch->waiting.assign(masters, std::deque<tlm::tlm_generic_payload*>());
+                ch->arbiter = Arbiter::create(policy, weights);
+            }
+        }
+        r.resize(masters);
+        b.resize(masters);
+    }
+
+    static BusRoute& route_of (tlm::tlm_generic_payload& trans) {
+        BusRoute* route = trans.get_extension<BusRoute>();
+        if (!route) {
+            route = new BusRoute;
+            trans.set_extension(route);
+        }
+        return *route;
+    }
+
+    tlm::tlm_sync_enum nb_transport_fw (int master, tlm::tlm_generic_payload& trans, tlm::tlm_phase& phase, sc_time& delay) {
+        if (phase == tlm::BEGIN_REQ) {
+            trans.acquire();
+            BusRoute& route = route_of(trans);
+            AXI_REQ& req = AXIPayloadPool::request(trans);
+            uint64_t local = 0;
+            route.master = master;
+            route.slave = map.decode(trans.get_address(), local);
+            route.id = req.id;
+            route.addr = trans.get_address();
+            route.parts.clear();
+            route.parent = nullptr;
+            if (route.slave < 0) {
+                trans.release();
+                trans.set_response_status(tlm::TLM_ADDRESS_ERROR_RESPONSE);
+                SC_REPORT_ERROR("Bus", "no slave at address");
+                return tlm::TLM_COMPLETED;
+            }
+
+            // remap to the slave-side view
+            req.id = (master << ID_SHIFT) | (req.id & ID_MASK);
+            trans.set_address(local);
+            if (map.block()) {
+                split(trans, route);
+            }
+            delay += hop_delay;
+        }
+        peq.notify(trans, phase, delay);
+        return tlm::TLM_ACCEPTED;
+    }
+
+    tlm::tlm_sync_enum nb_transport_bw (int slave, tlm::tlm_generic_payload& trans, tlm::tlm_phase& phase, sc_time& delay) {
+        (void)slave;
+        if (phase == tlm::BEGIN_RESP) {
+            delay += hop_delay;
+        }
+        peq.notify(trans, phase, delay);
+        return tlm::TLM_ACCEPTED;
+    }
 
-    SC_CTOR(Bus) {
+    // cuts a burst whose beats leave one channel into one INCR burst per
+    // run of beats that is contiguous in a channel's own address space;
+    // with the channel compacted out of the local address, that is usually
+    // one part per channel. Leaves route.parts empty when the burst fits on
+    // one channel as it is.
+    void split (tlm::tlm_generic_payload& trans, BusRoute& route) {
+        AXI_REQ req = AXIPayloadPool::request(trans);
+        req.addr = static_cast<uint32_t>(route.addr);
+        if (req.burst == BURST_FIXED) {
+            return; // every beat at one address
+        }
+        uint32_t beats = burst_beats(req);
+
+        struct run {
+            int channel;
+            AXI_REQ part;
+            std::vector<uint32_t> beats;
+        };
+        std::vector<run> runs;
+        bool in_place = true; // every beat on route.slave, moved as a whole
+        for (uint32_t n = 0; n < beats; n++) {
+            uint64_t local;
+            int channel = map.decode(beat_address(req, n), local);
+            in_place = in_place && channel == route.slave
+                       && local - beat_address(req, n) == trans.get_address() - route.addr;
+            auto it = std::find_if(runs.begin(), runs.end(), [&](const run& r) {
+                return r.channel == channel && beat_address(r.part, static_cast<uint32_t>(r.beats.size())) == local;
+            });
+            if (it == runs.end()) {
+                AXI_REQ part = req;
+                part.addr = static_cast<uint32_t>(local);
+                part.burst = BURST_INCR;
+                runs.push_back({ channel, part, {} });
+                it = runs.end() - 1;
+            }
+            it->beats.push_back(n);
+        }
+        if (in_place) {
+            return;
+        }
+
+        split_bursts++;
+        split_parts += runs.size();
+        route.reqs_left = route.resps_left = static_cast<uint32_t>(runs.size());
+        const unsigned char* byte_enable = trans.get_byte_enable_ptr();
+        for (run& r : runs) {
+            r.part.len = static_cast<uint32_t>(r.beats.size()) - 1;
+            tlm::tlm_generic_payload* p = part_pool.allocate();
+            AXIPayloadPool::setup(*p, r.part);
+            if (trans.is_write()) {
+                AXIExtension* ext = p->get_extension<AXIExtension>();
+                if (byte_enable) {
+                    ext->byte_enable.resize(r.beats.size() * BEAT_BYTES);
+                    p->set_byte_enable_ptr(ext->byte_enable.data());
+                    p->set_byte_enable_length(static_cast<unsigned int>(ext->byte_enable.size()));
+                }
+                for (size_t i = 0; i < r.beats.size(); i++) {
+                    std::memcpy(p->get_data_ptr() + i * BEAT_BYTES, trans.get_data_ptr() + r.beats[i] * BEAT_BYTES, BEAT_BYTES);
+                    if (byte_enable) {
+                        std::memcpy(ext->byte_enable.data() + i * BEAT_BYTES, byte_enable + r.beats[i] * BEAT_BYTES, BEAT_BYTES);
+                    }
+                }
+            }
+            BusRoute& part_route = route_of(*p);
+            part_route.master = route.master;
+            part_route.slave = r.channel;
+            part_route.id = route.id;
+            part_route.addr = beat_address(req, r.beats[0]);
+            part_route.parts.clear();
+            part_route.parent = &trans;
+            part_route.beats = std::move(r.beats);
+            route.parts.push_back(p);
+        }
+    }
+
+    void peq_cb (tlm::tlm_generic_payload& trans, const tlm::tlm_phase& phase) {
+        BusRoute& route = route_of(trans);
+        bool is_read = trans.is_read();
+
+        if (phase == tlm::BEGIN_REQ) {
+            if (route.parts.empty()) {
+                request(trans);
+            }
+            for (tlm::tlm_generic_payload* part : route.parts) {
+                request(*part);
+            }
+        }
+        else if (phase == tlm::END_REQ) {
+            addr_channel& ach = (is_read ? ar : aw)[route.slave];
+            ach.busy = false;
+            ach.busy_ns += (sc_time_stamp() - ach.busy_since).to_seconds() * 1e9;
+            if (!route.parent) {
+                forward_bw(trans, tlm::END_REQ);
+            } else if (--route_of(*route.parent).reqs_left == 0) {
+                forward_bw(*route.parent, tlm::END_REQ);
+            }
+            arbitrate(ach, route.slave, is_read);
+        }
+        else if (phase == tlm::BEGIN_RESP) {
+            if (route.parent) {
+                join(trans, route);
+            } else {
+                respond(trans);
+            }
+        }
+        else if (phase == tlm::END_RESP) {
+            resp_channel& rch = (is_read ? r : b)[route.master];
+            rch.active = nullptr;
+            if (route.parts.empty()) {
+                forward_fw(trans, tlm::END_RESP, route.slave);
+            }
+            trans.release();
+            dispatch(rch);
+        }
+    }
+
+    void request (tlm::tlm_generic_payload& trans) {
+        BusRoute& route = route_of(trans);
+        addr_channel& ach = (trans.is_read() ? ar : aw)[route.slave];
+        route.arrival = sc_time_stamp();
+        ach.waiting[route.master].push_back(&trans);
+        arbitrate(ach, route.slave, trans.is_read());
+    }
+
+    void respond (tlm::tlm_generic_payload& trans) {
+        BusRoute& route = route_of(trans);
+        resp_channel& rch = (trans.is_read() ? r : b)[route.master];
+        // restore the master-side view before handing the response back
+        AXIPayloadPool::request(trans).id = route.id;
+        trans.set_address(route.addr);
+        rch.waiting.push_back(&trans);
+        dispatch(rch);
+    }
+
+    // a part answered: its data goes into the master's buffer and the bus
+    // ends it at once; the last one answers the master
+    void join (tlm::tlm_generic_payload& part, BusRoute& route) {
+        tlm::tlm_generic_payload& whole = *route.parent;
+        if (part.is_read()) {
+            for (size_t i = 0; i < route.beats.size(); i++) {
+                std::memcpy(whole.get_data_ptr() + route.beats[i] * BEAT_BYTES, part.get_data_ptr() + i * BEAT_BYTES, BEAT_BYTES);
+            }
+        }
+        // the first answer sets the status, an error from any later one wins
+        if (whole.get_response_status() == tlm::TLM_INCOMPLETE_RESPONSE || part.is_response_error()) {
+            whole.set_response_status(part.get_response_status());
+        }
+        forward_fw(part, tlm::END_RESP, route.slave);
+        part.release();
+
+        if (--route_of(whole).resps_left == 0) {
+            respond(whole);
+        }
+    }
+
+    void arbitrate (addr_channel& ch, int slave, bool is_read) {
+        if (ch.busy) {
+            return;
+        }
+
+        std::vector<bool> req(ch.waiting.size());
+        int pending = 0;
+        for (size_t m = 0; m < ch.waiting.size(); m++) {
+            req[m] = !ch.waiting[m].empty();
+            pending += req[m];
+        }
+        if (pending == 0) {
+            return;
+        }
+
+        int m = ch.arbiter->pick(req);
+        tlm::tlm_generic_payload* trans = ch.waiting[m].front();
+        ch.waiting[m].pop_front();
+        ch.busy = true;
+        ch.busy_since = sc_time_stamp();
+        ch.grants++;
+        ch.bytes += burst_bytes(AXIPayloadPool::target_request(*trans));
+        ch.contended += pending > 1;
+        ch.wait_ns += (sc_time_stamp() - route_of(*trans).arrival).to_seconds() * 1e9;
+
+        tlm::tlm_phase phase = tlm::BEGIN_REQ;
+        sc_time delay = SC_ZERO_TIME;
+        tlm::tlm_sync_enum status = (is_read ? rd_init_socket : wr_init_socket)[slave]->nb_transport_fw(*trans, phase, delay);
+        if (status == tlm::TLM_UPDATED && phase == tlm::END_REQ) {
+            peq.notify(*trans, phase, delay);
+        }
+    }
+
+    void dispatch (resp_channel& ch) {
+        if (ch.active || ch.waiting.empty()) {
+            return;
+        }
+        ch.active = ch.waiting.front();
+        ch.waiting.pop_front();
+        tlm::tlm_sync_enum status = forward_bw(*ch.active, tlm::BEGIN_RESP);
+        if (status == tlm::TLM_COMPLETED) {
+            peq.notify(*ch.active, tlm::END_RESP, SC_ZERO_TIME);
+        }
+    }
+
+    tlm::tlm_sync_enum forward_bw (tlm::tlm_generic_payload& trans, tlm::tlm_phase phase) {
+        sc_time delay = SC_ZERO_TIME;
+        int master = route_of(trans).master;
+        return (trans.is_read() ? rd_target_socket : wr_target_socket)[master]->nb_transport_bw(trans, phase, delay);
+    }
+
+    void forward_fw (tlm::tlm_generic_payload& trans, tlm::tlm_phase phase, int slave) {
+        sc_time delay = SC_ZERO_TIME;
+        (trans.is_read() ? rd_init_socket : wr_init_socket)[slave]->nb_transport_fw(trans, phase, delay);
+    }
 
+    void report_channel (std::ostream& os, const char* name, size_t slave, const addr_channel& ch, double exe_time) const {
+        os << "[Bus][" << name << "][slave:" << slave << "] grants: " << ch.grants
+           << ", contended: " << ch.contended
+           << ", avg_wait: " << (ch.grants ? ch.wait_ns / ch.grants : 0) << " ns"
+           << ", utilization: " << (exe_time > 0 ? ch.busy_ns / exe_time : 0) << std::endl;
     }
 };
 
 
-#endif
\ No newline at end of file
+#endif
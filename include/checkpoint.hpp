@@ -0,0 +1,211 @@
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <type_traits>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// Checkpoint file: a fixed header, one page-aligned raw image (the memory
+// pages of a SparseMemory) and the serialized module state after it.
+//   [header][pad to a host page][image][state]
+// The image is written through a shared mapping of the file and restored
+// through a private one, so a restore reads no page until the run touches
+// it and runs restored from one file share its page cache.
+//
+// State is a flat little-endian byte stream in the order the modules write
+// it; tag() marks each module's part, so reading it back with a different
+// build fails on the tag instead of on garbage.
+struct CheckpointHeader {
+    char magic[8];         // "AXICKPT"
+    uint32_t version;      // 1
+    uint32_t reserved;
+    uint64_t image_offset; // host page aligned
+    uint64_t image_size;
+    uint64_t state_offset;
+    uint64_t state_size;
+};
+
+class CheckpointWriter {
+public:
+    explicit CheckpointWriter (const std::string& path) : path(path) {
+        fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("cannot create checkpoint: " + path);
+        }
+        header.image_offset = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    }
+
+    CheckpointWriter (const CheckpointWriter&) = delete;
+    CheckpointWriter& operator= (const CheckpointWriter&) = delete;
+
+    ~CheckpointWriter () {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    template <typename T>
+    void put (const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "checkpoint: put() needs a trivially copyable type");
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+        state.insert(state.end(), bytes, bytes + sizeof(T));
+    }
+
+    template <typename T>
+    void put (const std::vector<T>& values) {
+        static_assert(std::is_trivially_copyable<T>::value, "checkpoint: put() needs a trivially copyable type");
+        put<uint64_t>(values.size());
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(values.data());
+        state.insert(state.end(), bytes, bytes + values.size() * sizeof(T));
+    }
+
+    void put (const std::string& value) {
+        put(std::vector<char>(value.begin(), value.end()));
+    }
+
+    void tag (const std::string& name) {
+        put(name);
+    }
+
+    // bytes of image space in the file, to be filled before finish(); one
+    // image per checkpoint
+    uint8_t* image (uint64_t bytes) {
+        if (image_data) {
+            throw std::logic_error("checkpoint: image requested twice");
+        }
+        header.image_size = bytes;
+        if (bytes == 0) {
+            return nullptr;
+        }
+        if (ftruncate(fd, header.image_offset + bytes) < 0) {
+            throw std::runtime_error("cannot size checkpoint: " + path);
+        }
+        void* data = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, header.image_offset);
+        if (data == MAP_FAILED) {
+            throw std::runtime_error("cannot mmap checkpoint: " + path);
+        }
+        image_data = static_cast<uint8_t*>(data);
+        return image_data;
+    }
+
+    void finish () {
+        if (image_data) {
+            munmap(image_data, header.image_size);
+            image_data = nullptr;
+        }
+        std::memcpy(header.magic, "AXICKPT", 8);
+        header.version = 1;
+        header.state_offset = header.image_offset + header.image_size;
+        header.state_size = state.size();
+        if (pwrite(fd, &header, sizeof(header), 0) != sizeof(header)
+            || pwrite(fd, state.data(), state.size(), header.state_offset) != static_cast<ssize_t>(state.size())) {
+            throw std::runtime_error("cannot write checkpoint: " + path);
+        }
+        close(fd);
+        fd = -1;
+    }
+
+private:
+    std::string path;
+    int fd = -1;
+    CheckpointHeader header = {};
+    std::vector<uint8_t> state;
+    uint8_t* image_data = nullptr;
+};
+
+class CheckpointReader {
+public:
+    explicit CheckpointReader (const std::string& path) : path(path) {
+        fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("cannot open checkpoint: " + path);
+        }
+        if (pread(fd, &header, sizeof(header), 0) != sizeof(header)
+            || std::memcmp(header.magic, "AXICKPT", 8) != 0) {
+            throw std::runtime_error("not a checkpoint: " + path);
+        }
+        if (header.version != 1) {
+            throw std::runtime_error("unsupported checkpoint version: " + path);
+        }
+        state.resize(header.state_size);
+        if (pread(fd, state.data(), state.size(), header.state_offset) != static_cast<ssize_t>(state.size())) {
+            throw std::runtime_error("truncated checkpoint: " + path);
+        }
+    }
+
+    CheckpointReader (const CheckpointReader&) = delete;
+    CheckpointReader& operator= (const CheckpointReader&) = delete;
+
+    ~CheckpointReader () {
+        close(fd);
+    }
+
+    template <typename T>
+    void get (T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "checkpoint: get() needs a trivially copyable type");
+        std::memcpy(&value, take(sizeof(T)), sizeof(T));
+    }
+
+    template <typename T>
+    void get (std::vector<T>& values) {
+        static_assert(std::is_trivially_copyable<T>::value, "checkpoint: get() needs a trivially copyable type");
+        uint64_t count;
+        get(count);
+        if (count > (state.size() - pos) / sizeof(T)) {
+            throw std::runtime_error("truncated checkpoint: " + path);
+        }
+        values.resize(count);
+        std::memcpy(values.data(), take(count * sizeof(T)), count * sizeof(T));
+    }
+
+    void get (std::string& value) {
+        std::vector<char> chars;
+        get(chars);
+        value.assign(chars.begin(), chars.end());
+    }
+
+    void expect (const std::string& name) {
+        std::string found;
+        get(found);
+        if (found != name) {
+            throw std::runtime_error("checkpoint " + path + ": expected " + name + " state, found '" + found + "'");
+        }
+    }
+
+    // the image, mapped copy-on-write; the caller unmaps it
+    uint8_t* map_image (uint64_t& bytes) {
+        bytes = header.image_size;
+        if (bytes == 0) {
+            return nullptr;
+        }
+        void* data = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, header.image_offset);
+        if (data == MAP_FAILED) {
+            throw std::runtime_error("cannot mmap checkpoint: " + path);
+        }
+        return static_cast<uint8_t*>(data);
+    }
+
+private:
+    std::string path;
+    int fd = -1;
+    CheckpointHeader header;
+    std::vector<uint8_t> state;
+    size_t pos = 0;
+
+    const uint8_t* take (size_t bytes) {
+        if (bytes > state.size() - pos) {
+            throw std::runtime_error("truncated checkpoint: " + path);
+        }
+        const uint8_t* p = state.data() + pos;
+        pos += bytes;
+        return p;
+    }
+};
+
+#endif
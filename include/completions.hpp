@@ -0,0 +1,105 @@
+#ifndef COMPLETIONS_HPP
+#define COMPLETIONS_HPP
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <ostream>
+#include <stdexcept>
+#include <algorithm>
+#include <tuple>
+#include <cstdint>
+#include "channels/AXICommon.hpp"
+
+// One line per finished burst, so two builds of the model fed the same
+// seeded traffic can be compared burst by burst:
+//   type,id,bytes,issue_cycle,done_cycle
+// Cycles count rising clock edges from the first one; issue is the edge
+// AxVALID goes up, done the edge RLAST or the write response is taken.
+// Lines are written in completion order; sort both logs before comparing.
+struct completion {
+    uint32_t type;
+    uint32_t id;
+    uint64_t bytes;
+    uint64_t issue_cycle;
+    uint64_t done_cycle;
+
+    bool operator== (const completion& o) const {
+        return type == o.type && id == o.id && bytes == o.bytes
+            && issue_cycle == o.issue_cycle && done_cycle == o.done_cycle;
+    }
+
+    bool operator< (const completion& o) const {
+        return std::tie(issue_cycle, done_cycle, type, id, bytes)
+             < std::tie(o.issue_cycle, o.done_cycle, o.type, o.id, o.bytes);
+    }
+};
+
+inline std::ostream& operator<< (std::ostream& os, const completion& c) {
+    return os << (c.type == READ ? "R" : "W") << "," << c.id << "," << c.bytes << ","
+              << c.issue_cycle << "," << c.done_cycle;
+}
+
+inline uint64_t edge_index (double now_ns, double start_ns, double period_ns) {
+    return static_cast<uint64_t>((now_ns - start_ns) / period_ns + 0.5);
+}
+
+class CompletionLog {
+public:
+    CompletionLog (const std::string& path, double start_ns, double period_ns)
+        : out(path)
+        , start_ns(start_ns)
+        , period_ns(period_ns)
+    {
+        if (!out) {
+            throw std::runtime_error("cannot create completion log: " + path);
+        }
+        out << "type,id,bytes,issue_cycle,done_cycle\n";
+    }
+
+    void record (uint32_t type, uint32_t id, uint64_t bytes, double issue_ns, double done_ns) {
+        record({ type, id, bytes, edge_index(issue_ns, start_ns, period_ns), edge_index(done_ns, start_ns, period_ns) });
+    }
+
+    void record (const completion& c) {
+        out << c << "\n";
+    }
+
+    // every line of the log at path, sorted
+    static std::vector<completion> load (const std::string& path) {
+        std::ifstream in(path);
+        if (!in) {
+            throw std::runtime_error("cannot open completion log: " + path);
+        }
+        std::vector<completion> log;
+        std::string line;
+        std::getline(in, line); // header
+        while (std::getline(in, line)) {
+            if (line.empty()) {
+                continue;
+            }
+            std::istringstream fields(line);
+            std::string type, id, bytes, issue, done;
+            std::getline(fields, type, ',');
+            std::getline(fields, id, ',');
+            std::getline(fields, bytes, ',');
+            std::getline(fields, issue, ',');
+            std::getline(fields, done, ',');
+            if (done.empty()) {
+                throw std::runtime_error("malformed completion log line: " + line);
+            }
+            log.push_back({ static_cast<uint32_t>(type == "R" ? READ : WRITE), static_cast<uint32_t>(std::stoul(id)),
+                            std::stoull(bytes), std::stoull(issue), std::stoull(done) });
+        }
+        std::sort(log.begin(), log.end());
+        return log;
+    }
+
+private:
+    std::ofstream out;
+    double start_ns;
+    double period_ns;
+};
+
+#endif
@@ -1,10 +1,40 @@
 #pragma once
 #include <yaml-cpp/yaml.h>
+#include <string>
+#include <cstdint>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+// default abstraction level when config.yaml does not set common.model
+#ifndef AXI_DEFAULT_MODEL
+#define AXI_DEFAULT_MODEL "pin"
+#endif
+
+// synthetic traffic of one master (traffic.source: pattern)
+struct traffic_pattern {
+    std::string type;       // sequential | strided | uniform | hotspot | zipf
+    double read_ratio;      // fraction of bursts that are reads
+    uint64_t base;          // address window
+    uint64_t range;
+    uint64_t stride;        // strided: bytes between burst starts
+    uint32_t size;          // AxSIZE
+    uint32_t len;           // AxLEN
+    std::string burst;      // incr | wrap | fixed
+    double hot_fraction;    // hotspot: leading part of the window that is hot
+    double hot_probability; // hotspot: share of bursts sent there
+    double zipf_exponent;
+    double interval_ns;     // injection interval (mean when poisson)
+    bool poisson;
+};
 
 struct config {
 
     struct {
         double execution_time;
+        std::string model; // pin | lt | at | bus
     } common;
 
     struct {
@@ -13,21 +43,348 @@ struct config {
         double start_delay_ns;
     } clock;
 
+    struct {
+        std::string source; // random | trace | pattern
+        std::string mode;   // timestamp | backpressure
+        uint32_t queue_depth;
+        std::string trace;
+        uint64_t seed;
+        std::vector<traffic_pattern> patterns; // per master
+    } traffic;
+
+    struct {
+        uint32_t max_outstanding_reads;
+        uint32_t max_outstanding_writes;
+        std::string issue_policy; // parallel | alternate | read_first | write_drain
+        uint32_t write_high_watermark;
+        uint32_t write_low_watermark;
+    } master;
+
+    struct {
+        uint32_t reorder_window;
+        std::string write_ack; // accept | commit
+        uint32_t max_outstanding; // per direction
+        uint32_t read_interleave; // bursts whose R beats may interleave, 1 = none
+    } slave;
+
+    struct {
+        uint32_t banks;
+        uint32_t bank_groups;
+        double tRCD_ns;
+        double tRP_ns;
+        double tCAS_ns;
+        double tRAS_ns;
+        double tCCD_S_ns;
+        double tCCD_L_ns;
+        double tREFI_ns; // 0 disables refresh
+        double tRFC_ns;
+        std::string scheduler; // fcfs | frfcfs
+        uint32_t row_bytes;    // bytes per row (page)
+        std::string bank_hash; // none | xor
+    } dram;
+
+    struct {
+        uint32_t entries;        // lines held, 0 = no write buffer
+        uint32_t line_bytes;     // merge granularity
+        uint32_t high_watermark; // drain once this many lines are held...
+        uint32_t low_watermark;  // ...down to this many
+        double hit_ns;           // read served from the buffer
+    } write_buffer;
+
+    struct {
+        uint32_t entries;      // lines held, 0 = no prefetcher
+        uint32_t line_bytes;
+        uint32_t streams;      // streams tracked at once
+        std::string train;     // id | region
+        uint64_t region_bytes; // train: region
+        uint32_t threshold;    // stride repeats before prefetching
+        uint32_t degree;       // bursts prefetched per read
+        uint32_t distance;     // strides prefetching may run ahead
+        double hit_ns;         // read served from the buffer
+    } prefetch;
+
+    struct {
+        uint32_t page_bits;
+        std::string image; // raw image mapped in copy-on-write, "" = none
+        uint64_t image_base;
+        std::string dump;  // raw image written at end of run, "" = none
+    } memory;
+
+    struct {
+        double quantum_ns;
+    } lt;
+
+    struct {
+        uint32_t max_outstanding;
+    } at;
+
+    struct {
+        uint32_t masters;
+        uint32_t slaves;
+        std::string arbiter; // round_robin | fixed_priority | weighted
+        std::vector<uint32_t> weights;
+        double latency_cycles;
+        std::vector<std::pair<uint64_t, uint64_t>> address_map; // {base, size} per slave
+        std::string interleave; // range | line | page | xor, see address_map.hpp
+        uint32_t line_bytes;    // interleave: line block
+    } bus;
+
+    struct {
+        bool enable;
+        std::string file; // ".gz" suffix = gzip-streamed VCD
+        std::vector<std::string> channels; // ar | r | aw | w | b | clk
+        double start_ns;
+        double stop_ns;     // 0 = end of run
+        double duration_ns; // 0 = until stop_ns
+        uint64_t start_after_transactions;
+        double latency_trigger_ns; // 0 = no latency trigger
+    } trace;
+
+    struct {
+        std::string output; // file prefix, "" = no export
+        double interval_ns; // periodic export, 0 = end of run only
+        double window_ns;   // bandwidth timeline resolution
+        uint32_t window_slots; // timeline points cover the last window_slots steps
+        std::string completions; // per-burst completion log, "" = none
+        std::string transactions; // binary phase log of every burst (recorder.hpp), "" = none
+        uint32_t transaction_buffer; // records buffered per channel before a write
+    } stats;
+
+    struct {
+        std::string save;         // checkpoint file to write, "" = none
+        double at_ns;             // trigger: first edge at or after this time...
+        uint64_t at_transactions; // ...or this many finished bursts, when > 0
+        bool stop;                // end the run once saved
+        std::string restore;      // start from this checkpoint, "" = from reset
+    } checkpoint;
+
+    struct {
+        uint32_t ports;       // independent master/slave pairs
+        uint32_t threads;     // 0 = one per host thread
+        uint32_t sync_cycles; // cycles between worker barriers
+    } cycle;
+
 };
 
 class config_loader {
 public:
     config cfg;
 
-    void load_yaml (const std::string& path = "./config.yaml") {
+    // overrides are "dotted.key=value" pairs applied on top of the file;
+    // the value is parsed as YAML, so lists like "bus.weights=[2,1]" work
+    void load_yaml (const std::string& path = "./config.yaml", const std::vector<std::string>& overrides = {}) {
         YAML::Node config = YAML::LoadFile(path);
+        for (const std::string& entry : overrides) {
+            size_t eq = entry.find('=');
+            if (eq == std::string::npos || eq == 0) {
+                throw std::invalid_argument("config override must be key=value: " + entry);
+            }
+            std::vector<std::string> keys;
+            std::stringstream ss(entry.substr(0, eq));
+            std::string key;
+            while (std::getline(ss, key, '.')) {
+                keys.push_back(key);
+            }
+            set_path(config, keys, 0, YAML::Load(entry.substr(eq + 1)));
+        }
 
         // --- common
         cfg.common.execution_time = config["common"]["execution_time"].as<double>();
+        cfg.common.model          = config["common"]["model"].as<std::string>(AXI_DEFAULT_MODEL);
 
         // --- clock
         cfg.clock.period_ns      = config["clock"]["period_ns"].as<double>();
         cfg.clock.duty_cycle     = config["clock"]["duty_cycle"].as<double>();
         cfg.clock.start_delay_ns = config["clock"]["start_delay_ns"].as<double>();
+
+        // --- traffic
+        cfg.traffic.source      = config["traffic"]["source"].as<std::string>("random");
+        cfg.traffic.mode        = config["traffic"]["mode"].as<std::string>("timestamp");
+        cfg.traffic.queue_depth = config["traffic"]["queue_depth"].as<uint32_t>(16);
+        cfg.traffic.trace       = config["traffic"]["trace"].as<std::string>("");
+        cfg.traffic.seed        = config["traffic"]["seed"].as<uint64_t>(1);
+
+        // --- master
+        cfg.master.max_outstanding_reads  = config["master"]["max_outstanding_reads"].as<uint32_t>(16);
+        cfg.master.max_outstanding_writes = config["master"]["max_outstanding_writes"].as<uint32_t>(16);
+        cfg.master.issue_policy           = config["master"]["issue_policy"].as<std::string>("parallel");
+        cfg.master.write_high_watermark   = config["master"]["write_high_watermark"].as<uint32_t>(12);
+        cfg.master.write_low_watermark    = config["master"]["write_low_watermark"].as<uint32_t>(4);
+
+        // --- slave
+        cfg.slave.reorder_window  = config["slave"]["reorder_window"].as<uint32_t>(1);
+        cfg.slave.write_ack       = config["slave"]["write_ack"].as<std::string>("accept");
+        cfg.slave.max_outstanding = config["slave"]["max_outstanding"].as<uint32_t>(16);
+        cfg.slave.read_interleave = config["slave"]["read_interleave"].as<uint32_t>(1);
+
+        // --- dram
+        YAML::Node dram = config["dram"];
+        cfg.dram.banks       = dram["banks"].as<uint32_t>(8);
+        cfg.dram.bank_groups = dram["bank_groups"].as<uint32_t>(2);
+        cfg.dram.tRCD_ns     = dram["tRCD_ns"].as<double>(14);
+        cfg.dram.tRP_ns      = dram["tRP_ns"].as<double>(14);
+        cfg.dram.tCAS_ns     = dram["tCAS_ns"].as<double>(14);
+        cfg.dram.tRAS_ns     = dram["tRAS_ns"].as<double>(32);
+        cfg.dram.tCCD_S_ns   = dram["tCCD_S_ns"].as<double>(2.5);
+        cfg.dram.tCCD_L_ns   = dram["tCCD_L_ns"].as<double>(5);
+        cfg.dram.tREFI_ns    = dram["tREFI_ns"].as<double>(7800);
+        cfg.dram.tRFC_ns     = dram["tRFC_ns"].as<double>(350);
+        cfg.dram.scheduler   = dram["scheduler"].as<std::string>("frfcfs");
+        cfg.dram.row_bytes   = dram["row_bytes"].as<uint32_t>(4096);
+        cfg.dram.bank_hash   = dram["bank_hash"].as<std::string>("none");
+
+        // --- write_buffer
+        YAML::Node write_buffer = config["write_buffer"];
+        cfg.write_buffer.entries        = write_buffer["entries"].as<uint32_t>(0);
+        cfg.write_buffer.line_bytes     = write_buffer["line_bytes"].as<uint32_t>(2048);
+        cfg.write_buffer.high_watermark = write_buffer["high_watermark"].as<uint32_t>(24);
+        cfg.write_buffer.low_watermark  = write_buffer["low_watermark"].as<uint32_t>(8);
+        cfg.write_buffer.hit_ns         = write_buffer["hit_ns"].as<double>(2);
+
+        // --- prefetch
+        YAML::Node prefetch = config["prefetch"];
+        cfg.prefetch.entries      = prefetch["entries"].as<uint32_t>(0);
+        cfg.prefetch.line_bytes   = prefetch["line_bytes"].as<uint32_t>(512);
+        cfg.prefetch.streams      = prefetch["streams"].as<uint32_t>(8);
+        cfg.prefetch.train        = prefetch["train"].as<std::string>("region");
+        cfg.prefetch.region_bytes = prefetch["region_bytes"].as<uint64_t>(4096);
+        cfg.prefetch.threshold    = prefetch["threshold"].as<uint32_t>(2);
+        cfg.prefetch.degree       = prefetch["degree"].as<uint32_t>(2);
+        cfg.prefetch.distance     = prefetch["distance"].as<uint32_t>(4);
+        cfg.prefetch.hit_ns       = prefetch["hit_ns"].as<double>(2);
+
+        // --- memory
+        cfg.memory.page_bits  = config["memory"]["page_bits"].as<uint32_t>(16);
+        cfg.memory.image      = config["memory"]["image"].as<std::string>("");
+        cfg.memory.image_base = config["memory"]["image_base"].as<uint64_t>(0);
+        cfg.memory.dump       = config["memory"]["dump"].as<std::string>("");
+
+        // --- lt
+        cfg.lt.quantum_ns = config["lt"]["quantum_ns"].as<double>(1000);
+
+        // --- at
+        cfg.at.max_outstanding   = config["at"]["max_outstanding"].as<uint32_t>(16);
+
+        // --- bus
+        YAML::Node bus = config["bus"];
+        cfg.bus.masters        = bus["masters"].as<uint32_t>(1);
+        cfg.bus.slaves         = bus["slaves"].as<uint32_t>(1);
+        cfg.bus.arbiter        = bus["arbiter"].as<std::string>("round_robin");
+        cfg.bus.latency_cycles = bus["latency_cycles"].as<double>(1);
+        cfg.bus.interleave     = bus["interleave"].as<std::string>("range");
+        cfg.bus.line_bytes     = bus["line_bytes"].as<uint32_t>(128);
+        cfg.bus.weights.clear();
+        if (bus["weights"]) {
+            cfg.bus.weights = bus["weights"].as<std::vector<uint32_t>>();
+        }
+        cfg.bus.weights.resize(cfg.bus.masters, 1);
+        cfg.bus.address_map.clear();
+        if (bus["address_map"]) {
+            for (const YAML::Node& region : bus["address_map"]) {
+                cfg.bus.address_map.push_back({ region["base"].as<uint64_t>(), region["size"].as<uint64_t>() });
+            }
+        } else {
+            // equal, contiguous windows
+            uint64_t slave_size = bus["slave_size"].as<uint64_t>(0x10000);
+            for (uint32_t s = 0; s < cfg.bus.slaves; s++) {
+                cfg.bus.address_map.push_back({ s * slave_size, slave_size });
+            }
+        }
+
+        // --- trace
+        YAML::Node trace = config["trace"];
+        cfg.trace.enable      = trace["enable"].as<bool>(false);
+        cfg.trace.file        = trace["file"].as<std::string>("axi_waveform.vcd.gz");
+        cfg.trace.channels    = trace["channels"].as<std::vector<std::string>>(std::vector<std::string>{ "ar", "r", "aw", "w", "b" });
+        cfg.trace.start_ns    = trace["start_ns"].as<double>(0);
+        cfg.trace.stop_ns     = trace["stop_ns"].as<double>(0);
+        cfg.trace.duration_ns = trace["duration_ns"].as<double>(0);
+        cfg.trace.start_after_transactions = trace["start_after_transactions"].as<uint64_t>(0);
+        cfg.trace.latency_trigger_ns       = trace["latency_trigger_ns"].as<double>(0);
+
+        // --- stats
+        cfg.stats.output      = config["stats"]["output"].as<std::string>("");
+        cfg.stats.interval_ns = config["stats"]["interval_ns"].as<double>(0);
+        cfg.stats.window_ns   = config["stats"]["window_ns"].as<double>(1000);
+        cfg.stats.window_slots = config["stats"]["window_slots"].as<uint32_t>(4);
+        cfg.stats.completions = config["stats"]["completions"].as<std::string>("");
+        cfg.stats.transactions       = config["stats"]["transactions"].as<std::string>("");
+        cfg.stats.transaction_buffer = config["stats"]["transaction_buffer"].as<uint32_t>(65536);
+
+        // --- checkpoint
+        cfg.checkpoint.save            = config["checkpoint"]["save"].as<std::string>("");
+        cfg.checkpoint.at_ns           = config["checkpoint"]["at_ns"].as<double>(0);
+        cfg.checkpoint.at_transactions = config["checkpoint"]["at_transactions"].as<uint64_t>(0);
+        cfg.checkpoint.stop            = config["checkpoint"]["stop"].as<bool>(true);
+        cfg.checkpoint.restore         = config["checkpoint"]["restore"].as<std::string>("");
+
+        // --- cycle
+        cfg.cycle.ports       = config["cycle"]["ports"].as<uint32_t>(1);
+        cfg.cycle.threads     = config["cycle"]["threads"].as<uint32_t>(0);
+        cfg.cycle.sync_cycles = config["cycle"]["sync_cycles"].as<uint32_t>(1024);
+
+        // --- traffic.pattern, overridden field by field from traffic.masters[i]
+        YAML::Node traffic = config["traffic"];
+        traffic_pattern defaults = load_pattern(traffic["pattern"], default_pattern());
+        cfg.traffic.patterns.clear();
+        for (uint32_t m = 0; m < std::max<uint32_t>(cfg.bus.masters, 1); m++) {
+            YAML::Node override_node = traffic["masters"] && m < traffic["masters"].size() ? traffic["masters"][m] : YAML::Node();
+            cfg.traffic.patterns.push_back(load_pattern(override_node, defaults));
+        }
+    }
+
+private:
+    // node is a handle into the tree, so assigning through it edits config
+    static void set_path (YAML::Node node, const std::vector<std::string>& keys, size_t i, const YAML::Node& value) {
+        bool index = node.IsSequence() && keys[i].find_first_not_of("0123456789") == std::string::npos;
+        if (i + 1 == keys.size()) {
+            if (index) {
+                node[std::stoul(keys[i])] = value;
+            } else {
+                node[keys[i]] = value;
+            }
+            return;
+        }
+        if (index) {
+            set_path(node[std::stoul(keys[i])], keys, i + 1, value);
+        } else {
+            set_path(node[keys[i]], keys, i + 1, value);
+        }
+    }
+
+    static traffic_pattern default_pattern () {
+        traffic_pattern p;
+        p.type            = "sequential";
+        p.read_ratio      = 0.5;
+        p.base            = 0;
+        p.range           = 0x10000;
+        p.stride          = 0x1000;
+        p.size            = 7;
+        p.len             = 15;
+        p.burst           = "incr";
+        p.hot_fraction    = 0.1;
+        p.hot_probability = 0.9;
+        p.zipf_exponent   = 1.0;
+        p.interval_ns     = 2.5;
+        p.poisson         = false;
+        return p;
+    }
+
+    static traffic_pattern load_pattern (const YAML::Node& node, const traffic_pattern& d) {
+        traffic_pattern p;
+        p.type            = node["type"].as<std::string>(d.type);
+        p.read_ratio      = node["read_ratio"].as<double>(d.read_ratio);
+        p.base            = node["base"].as<uint64_t>(d.base);
+        p.range           = node["range"].as<uint64_t>(d.range);
+        p.stride          = node["stride"].as<uint64_t>(d.stride);
+        p.size            = node["size"].as<uint32_t>(d.size);
+        p.len             = node["len"].as<uint32_t>(d.len);
+        p.burst           = node["burst"].as<std::string>(d.burst);
+        p.hot_fraction    = node["hot_fraction"].as<double>(d.hot_fraction);
+        p.hot_probability = node["hot_probability"].as<double>(d.hot_probability);
+        p.zipf_exponent   = node["zipf_exponent"].as<double>(d.zipf_exponent);
+        p.interval_ns     = node["interval_ns"].as<double>(d.interval_ns);
+        p.poisson         = node["poisson"].as<bool>(d.poisson);
+        return p;
     }
 };
\ No newline at end of file
@@ -0,0 +1,1004 @@
+#ifndef CYCLE_HPP
+#define CYCLE_HPP
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+#include "config.hpp"
+#include "dram.hpp"
+#include "issue.hpp"
+#include "traffic.hpp"
+#include "completions.hpp"
+#include "channels/AXICommon.hpp"
+#include "channels/AXIBurst.hpp"
+#include "channels/AXITable.hpp"
+
+// Native cycle-based engine for the pin-level model, without the SystemC
+// kernel: N independent AXIMaster/AXISlave pairs ("ports"), each driven by
+// its own traffic source (master index = port) and DRAM model, spread over
+// a pool of threads.
+//
+// Every SC_THREAD of the pair becomes a state machine that runs the same
+// steps on the same edges as the SystemC build. Queues, tables and flags
+// the threads share follow the discipline of AXIHandshake.hpp (a change
+// shows from the next edge, a timed-phase change from this one), so the
+// order the threads run in within a phase does not matter. A cycle has two
+// evaluate/commit phases:
+//   timed   threads whose wait(t) ends after the previous edge and no later
+//           than this one (DRAM data ready, B due, source time); their pin
+//           writes are committed before the edge sees them
+//   edge    every thread waiting for the clock
+// Pins live in structure-of-arrays buffers, one entry per port: threads
+// read `cur` and write `next`, and commit copies next over cur. Data lanes
+// do not affect timing and are not modeled.
+//
+// Ports share nothing, so each worker advances its own range of ports and
+// the workers only meet at a barrier every sync_cycles cycles.
+class CycleEngine {
+public:
+    // end-of-run counters of one port
+    struct totals {
+        uint64_t read_count = 0;
+        uint64_t write_count = 0;
+        double read_bytes = 0;
+        double written_bytes = 0;
+        double total_read_latency = 0;  // ns, AR issue -> RLAST
+        double total_write_latency = 0; // ns, AW issue -> B
+        uint64_t reorder_count = 0;
+    };
+
+    CycleEngine (const CycleEngine&) = delete;
+    CycleEngine& operator= (const CycleEngine&) = delete;
+
+    explicit CycleEngine (const config& cfg)
+        : cfg(cfg)
+        , ports(std::max<uint32_t>(cfg.cycle.ports, 1))
+        , start_ps(to_ps(cfg.clock.start_delay_ns))
+        , period_ps(to_ps(cfg.clock.period_ns))
+    {
+        if (period_ps == 0) {
+            throw std::invalid_argument("cycle engine: clock.period_ns rounds to 0 ps");
+        }
+        if (!cfg.checkpoint.save.empty() || !cfg.checkpoint.restore.empty()) {
+            throw std::invalid_argument("cycle engine: checkpoint.save / checkpoint.restore need the pin model");
+        }
+        if (cfg.write_buffer.entries > 0) {
+            throw std::invalid_argument("cycle engine: write_buffer is not modeled, set write_buffer.entries: 0");
+        }
+        if (cfg.slave.read_interleave > 1) {
+            throw std::invalid_argument("cycle engine: R interleaving is not modeled, set slave.read_interleave: 1");
+        }
+        if (cfg.prefetch.entries > 0) {
+            throw std::invalid_argument("cycle engine: prefetch is not modeled, set prefetch.entries: 0");
+        }
+        cur.resize(ports);
+        next.resize(ports);
+        std::vector<std::vector<uint8_t>*> cf = cur.flags(), nf = next.flags();
+        for (size_t i = 0; i < cf.size(); i++) {
+            flag_lanes.push_back({ cf[i], nf[i] });
+        }
+        std::vector<std::vector<uint32_t>*> cw = cur.words(), nw = next.words();
+        for (size_t i = 0; i < cw.size(); i++) {
+            word_lanes.push_back({ cw[i], nw[i] });
+        }
+        for (uint32_t p = 0; p < ports; p++) {
+            state.emplace_back(new port(cfg, p));
+        }
+    }
+
+    uint32_t port_count () const {
+        return ports;
+    }
+
+    const std::vector<completion>& completions (uint32_t p) const {
+        return state[p]->done;
+    }
+
+    const totals& port_totals (uint32_t p) const {
+        return state[p]->sum;
+    }
+
+    const DRAMModel& dram (uint32_t p) const {
+        return state[p]->dram;
+    }
+
+    // simulates common.execution_time on `threads` workers (0 = one per
+    // host thread)
+    void run (uint32_t threads) {
+        uint64_t until_ps = to_ps(cfg.common.execution_time);
+        uint64_t edges = until_ps >= start_ps ? (until_ps - start_ps) / period_ps + 1 : 0;
+        uint64_t sync = std::max<uint64_t>(cfg.cycle.sync_cycles, 1);
+
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        threads = std::min(threads, ports);
+
+        barrier sync_point(threads);
+        auto worker = [&](uint32_t w) {
+            uint32_t lo = uint64_t(ports) * w / threads;
+            uint32_t hi = uint64_t(ports) * (w + 1) / threads;
+            for (uint32_t p = lo; p < hi; p++) {
+                initialize(p);
+            }
+            for (uint64_t k = 0; k < edges; k += sync) {
+                uint64_t end = std::min(edges, k + sync);
+                for (uint32_t p = lo; p < hi; p++) {
+                    for (uint64_t c = k; c < end; c++) {
+                        cycle(p, c);
+                    }
+                }
+                sync_point.wait();
+            }
+        };
+
+        std::vector<std::thread> pool;
+        for (uint32_t w = 1; w < threads; w++) {
+            pool.emplace_back(worker, w);
+        }
+        worker(0);
+        for (std::thread& t : pool) {
+            t.join();
+        }
+    }
+
+    // sc_time(ns, SC_NS) at 1 ps resolution, rounded the way the kernel does
+    static uint64_t to_ps (double ns) {
+        if (ns == 0) {
+            return 0;
+        }
+        volatile double tmp = ns * 1000.0 + 0.5;
+        return static_cast<uint64_t>(static_cast<int64_t>(tmp));
+    }
+
+    // sc_time_stamp().to_seconds() * 1e9, bit for bit
+    static double to_ns (uint64_t ps) {
+        return double(ps) * 1000.0 * 1e-15 * 1e9;
+    }
+
+private:
+    // ---- channel state, one entry per port
+    struct wires {
+        std::vector<uint8_t> arvalid, arready, rvalid, rready, rlast;
+        std::vector<uint8_t> awvalid, awready, wvalid, wready, wlast, bvalid, bready;
+        std::vector<uint32_t> arid, araddr, arsize, arlen, arburst, rid;
+        std::vector<uint32_t> awid, awaddr, awsize, awlen, awburst, wid, bid;
+
+        void resize (uint32_t n) {
+            for (std::vector<uint8_t>* v : flags()) {
+                v->assign(n, 0);
+            }
+            for (std::vector<uint32_t>* v : words()) {
+                v->assign(n, 0);
+            }
+        }
+
+        std::vector<std::vector<uint8_t>*> flags () {
+            return { &arvalid, &arready, &rvalid, &rready, &rlast, &awvalid, &awready, &wvalid, &wready, &wlast, &bvalid, &bready };
+        }
+
+        std::vector<std::vector<uint32_t>*> words () {
+            return { &arid, &araddr, &arsize, &arlen, &arburst, &rid, &awid, &awaddr, &awsize, &awlen, &awburst, &wid, &bid };
+        }
+    };
+
+    struct barrier {
+        explicit barrier (uint32_t count) : count(count) {}
+
+        void wait () {
+            std::unique_lock<std::mutex> lock(mutex);
+            uint64_t gen = generation;
+            if (++arrived == count) {
+                arrived = 0;
+                generation++;
+                cv.notify_all();
+                return;
+            }
+            cv.wait(lock, [&] { return generation != gen; });
+        }
+
+        uint32_t count;
+        uint32_t arrived = 0;
+        uint64_t generation = 0;
+        std::mutex mutex;
+        std::condition_variable cv;
+    };
+
+    // ---- per-port model state
+    struct queued_req {
+        AXI_REQ req;
+        uint64_t seq;
+    };
+
+    // EdgeStamp, EdgeTail and EdgeSampled<bool> of AXIHandshake.hpp on the
+    // engine's clock: after_edge tells the edge phase from the timed one
+    struct stamp {
+        uint64_t ps = 0;
+        bool after_edge = false;
+
+        bool operator== (const stamp& o) const {
+            return ps == o.ps && after_edge == o.after_edge;
+        }
+    };
+
+    struct tail {
+        stamp last;
+        uint32_t count = 0;
+    };
+
+    struct sampled_flag {
+        bool value = false;
+        bool before = false;
+        stamp at;
+    };
+
+    // a queue head ar_process or aw_process was granted and takes off on
+    // the edge at due_ps
+    struct claim {
+        uint64_t due_ps = 0;
+        bool open = false;
+    };
+
+    struct b_entry {
+        uint32_t slot;
+        double ready;
+    };
+
+    enum thread_id { S_B, S_W, S_AW, S_R, S_AR, M_B, M_W, M_AW, M_R, M_AR, M_GEN, THREADS };
+
+    // where a thread continues, and when
+    struct thread_state {
+        int pc = 0;
+        bool timed = false; // waiting for wake_ps rather than the next edge
+        bool done = false;
+        uint64_t wake_ps = 0;
+    };
+
+    struct port {
+        port (const config& cfg, uint32_t index)
+            : source(make_traffic_source(cfg, index))
+            , backpressure(cfg.traffic.mode == "backpressure")
+            , queue_depth(cfg.traffic.queue_depth)
+            , rd_fifo(cfg.traffic.queue_depth + 1)
+            , wr_fifo(cfg.traffic.queue_depth + 1)
+            , m_ar(cfg.master.max_outstanding_reads)
+            , m_aw(cfg.master.max_outstanding_writes)
+            , scheduler(cfg.master.issue_policy, cfg.master.write_high_watermark, cfg.master.write_low_watermark)
+            , dram(cfg)
+            , reorder_window(cfg.slave.reorder_window)
+            , ack_on_commit(cfg.slave.write_ack == "commit")
+            , s_ar(cfg.slave.max_outstanding)
+            , s_aw(cfg.slave.max_outstanding)
+            , s_aw_fifo(cfg.slave.max_outstanding)
+        {
+            s_ar_fifo.reserve(s_ar.capacity());
+            b_queue.reserve(s_aw.capacity());
+        }
+
+        // master
+        std::unique_ptr<TrafficSource> source;
+        bool backpressure;
+        uint32_t queue_depth;
+        RingQueue<queued_req> rd_fifo;
+        RingQueue<queued_req> wr_fifo;
+        tail rd_tail;
+        tail wr_tail;
+        claim ar_claim;
+        claim aw_claim;
+        SlotTable<AXI_REQ> m_ar;
+        SlotTable<AXI_REQ> m_aw;
+        tail m_ar_released;
+        tail m_aw_released;
+        IssueScheduler scheduler;
+        uint64_t next_seq = 0;
+        sampled_flag ar_busy;
+        sampled_flag aw_busy;
+        uint64_t decided_ps = UINT64_MAX;
+        bool grant_rd = false;
+        bool grant_wr = false;
+
+        // slave
+        DRAMModel dram;
+        uint32_t reorder_window;
+        bool ack_on_commit;
+        SlotTable<AXI_REQ> s_ar;
+        SlotTable<AXI_REQ> s_aw;
+        tail s_ar_released;
+        tail s_aw_released;
+        std::vector<uint32_t> s_ar_fifo;
+        RingQueue<uint32_t> s_aw_fifo;
+        tail s_ar_tail;
+        tail s_aw_tail;
+        std::vector<b_entry> b_queue;
+        tail b_tail;
+        AXI_REQ w_req;             // the burst slave w takes
+        bool w_open = false;
+        uint64_t w_committed_ps = UINT64_MAX;
+        double w_committed_ready = 0;
+
+        // thread locals
+        thread_state th[THREADS];
+        uint64_t now_ps = 0;
+        bool in_edge = false;       // edge phase, the clock has risen
+        uint64_t edge = 0;          // index of the current or next edge
+        AXI_REQ gen_req;
+        double gen_time_ns = 0;
+        std::vector<AXI_REQ> gen_parts;
+        size_t gen_part = 0;
+        uint32_t w_id = 0;
+        uint32_t w_total = 0;
+        uint32_t w_offset = 0;
+        uint32_t b_id = 0;
+        uint32_t sr_slot = 0;
+        uint32_t sr_offset = 0;
+        uint32_t sw_slot = 0;
+        b_entry sb_entry = { 0, 0 };
+
+        std::vector<completion> done;
+        totals sum;
+    };
+
+    const config& cfg;
+    uint32_t ports;
+    uint64_t start_ps;
+    uint64_t period_ps;
+    wires cur;
+    wires next;
+    std::vector<std::unique_ptr<port>> state;
+    // {cur, next} of every signal, for commit
+    std::vector<std::pair<std::vector<uint8_t>*, std::vector<uint8_t>*>> flag_lanes;
+    std::vector<std::pair<std::vector<uint32_t>*, std::vector<uint32_t>*>> word_lanes;
+
+    uint64_t edge_ps (uint64_t k) const {
+        return start_ps + k * period_ps;
+    }
+
+    void commit (uint32_t p) {
+        for (const auto& lane : flag_lanes) {
+            (*lane.first)[p] = (*lane.second)[p];
+        }
+        for (const auto& lane : word_lanes) {
+            (*lane.first)[p] = (*lane.second)[p];
+        }
+    }
+
+    // time 0: every thread runs once up to its first wait
+    void initialize (uint32_t p) {
+        port& s = *state[p];
+        s.now_ps = 0;
+        s.in_edge = false;
+        for (int t = 0; t < THREADS; t++) {
+            step(p, s, static_cast<thread_id>(t));
+        }
+        commit(p);
+    }
+
+    void cycle (uint32_t p, uint64_t k) {
+        port& s = *state[p];
+        uint64_t at = edge_ps(k);
+
+        // timed phase, in time order, a commit per distinct time
+        while (true) {
+            uint64_t wake = UINT64_MAX;
+            for (const thread_state& t : s.th) {
+                if (t.timed && !t.done) {
+                    wake = std::min(wake, t.wake_ps);
+                }
+            }
+            if (wake > at) {
+                break;
+            }
+            s.now_ps = wake;
+            s.in_edge = false;
+            for (int t = 0; t < THREADS; t++) {
+                if (s.th[t].timed && !s.th[t].done && s.th[t].wake_ps == wake) {
+                    s.th[t].timed = false;
+                    step(p, s, static_cast<thread_id>(t));
+                }
+            }
+            commit(p);
+        }
+
+        // edge phase
+        s.now_ps = at;
+        s.in_edge = true;
+        s.edge = k;
+        for (int t = 0; t < THREADS; t++) {
+            if (!s.th[t].timed && !s.th[t].done) {
+                step(p, s, static_cast<thread_id>(t));
+            }
+        }
+        commit(p);
+    }
+
+    void step (uint32_t p, port& s, thread_id t) {
+        switch (t) {
+        case S_B:   slave_b(p, s);    break;
+        case S_W:   slave_w(p, s);    break;
+        case S_AW:  slave_aw(p, s);   break;
+        case S_R:   slave_r(p, s);    break;
+        case S_AR:  slave_ar(p, s);   break;
+        case M_B:   master_b(p, s);   break;
+        case M_W:   master_w(p, s);   break;
+        case M_AW:  master_aw(p, s);  break;
+        case M_R:   master_r(p, s);   break;
+        case M_AR:  master_ar(p, s);  break;
+        case M_GEN: master_gen(p, s); break;
+        default:    break;
+        }
+    }
+
+    // wait(ready - now, SC_NS) from `now`; false when it rounds to no wait
+    static bool sleep_until (port& s, thread_state& th, double ready_ns) {
+        uint64_t wake = s.now_ps + to_ps(ready_ns - to_ns(s.now_ps));
+        if (wake == s.now_ps) {
+            return false;
+        }
+        th.timed = true;
+        th.wake_ps = wake;
+        return true;
+    }
+
+    double now_ns (const port& s) const {
+        return to_ns(s.now_ps);
+    }
+
+    // cycle index of the current time, which is an edge whenever a burst
+    // is issued or finishes
+    uint64_t now_cycle (const port& s) const {
+        return edge_index(now_ns(s), to_ns(start_ps), to_ns(period_ps));
+    }
+
+    static bool seen (const port& s, const stamp& c) {
+        return c.ps < s.now_ps || (c.ps == s.now_ps && !c.after_edge && s.in_edge);
+    }
+
+    static void pushed (const port& s, tail& t) {
+        stamp now = { s.now_ps, s.in_edge };
+        t.count = now == t.last ? t.count + 1 : 1;
+        t.last = now;
+    }
+
+    static uint32_t unseen (const port& s, const tail& t) {
+        return seen(s, t.last) ? 0 : t.count;
+    }
+
+    static void set (const port& s, sampled_flag& f, bool v) {
+        stamp now = { s.now_ps, s.in_edge };
+        if (!(now == f.at)) {
+            f.before = f.value;
+            f.at = now;
+        }
+        f.value = v;
+    }
+
+    static bool get (const port& s, const sampled_flag& f) {
+        return seen(s, f.at) ? f.value : f.before;
+    }
+
+    static bool slot_free (const port& s, const SlotTable<AXI_REQ>& table, const tail& released) {
+        return table.capacity() - table.size() > unseen(s, released);
+    }
+
+    // ================= master: AXIMaster's threads
+
+    static bool leaving (const port& s, const claim& c) {
+        return c.open && s.now_ps == c.due_ps && s.in_edge;
+    }
+
+    bool overlaps_outstanding (port& s, const AXI_REQ& req, SlotTable<AXI_REQ>& table, const tail& released) {
+        for (uint32_t slot = 0; slot < table.capacity(); slot++) {
+            if (table.contains(slot) && bursts_overlap(req, table[slot])) {
+                return true;
+            }
+        }
+        for (uint32_t i = 0; i < unseen(s, released); i++) {
+            if (bursts_overlap(req, table[table.released(i)])) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool reads_outstanding (port& s) {
+        for (uint32_t id = 0; id < s.m_ar.capacity(); id++) {
+            if (s.m_ar.contains(id) && s.m_ar[id].issue_time < now_ns(s)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool read_blocked (port& s, const queued_req& q) {
+        for (size_t i = 0; i < s.wr_fifo.size() && s.wr_fifo[i].seq < q.seq; i++) {
+            if (bursts_overlap(q.req, s.wr_fifo[i].req)) {
+                return true;
+            }
+        }
+        return overlaps_outstanding(s, q.req, s.m_aw, s.m_aw_released);
+    }
+
+    bool write_blocked (port& s, const queued_req& q) {
+        for (size_t i = 0; i < s.rd_fifo.size() && s.rd_fifo[i].seq < q.seq; i++) {
+            if (bursts_overlap(q.req, s.rd_fifo[i].req)) {
+                return true;
+            }
+        }
+        return overlaps_outstanding(s, q.req, s.m_ar, s.m_ar_released);
+    }
+
+    bool can_issue (port& s, uint32_t type) {
+        if (type == READ) {
+            return !get(s, s.ar_busy) && s.rd_fifo.size() > unseen(s, s.rd_tail)
+                && slot_free(s, s.m_ar, s.m_ar_released) && !read_blocked(s, s.rd_fifo.front());
+        }
+        return !get(s, s.aw_busy) && s.wr_fifo.size() > unseen(s, s.wr_tail)
+            && slot_free(s, s.m_aw, s.m_aw_released) && !write_blocked(s, s.wr_fifo.front());
+    }
+
+    bool granted (port& s, uint32_t type) {
+        if (s.decided_ps != s.now_ps) {
+            s.decided_ps = s.now_ps;
+            uint32_t writes_queued = s.wr_fifo.size() - unseen(s, s.wr_tail);
+            s.scheduler.decide(can_issue(s, READ), can_issue(s, WRITE), writes_queued, s.grant_rd, s.grant_wr);
+        }
+        return type == READ ? s.grant_rd : s.grant_wr;
+    }
+
+    void finish (port& s, const AXI_REQ& req) {
+        s.done.push_back({ req.type, req.id, burst_bytes(req),
+                           edge_index(req.issue_time, to_ns(start_ps), to_ns(period_ps)), now_cycle(s) });
+    }
+
+    enum { GEN_NEXT, GEN_SPLIT, GEN_PUSH };
+
+    void master_gen (uint32_t, port& s) {
+        thread_state& th = s.th[M_GEN];
+        while (true) {
+            switch (th.pc) {
+            case GEN_NEXT:
+                if (!s.source->next(s.gen_req, s.gen_time_ns)) {
+                    th.done = true;
+                    return;
+                }
+                th.pc = GEN_SPLIT;
+                if (!s.backpressure && s.gen_time_ns > now_ns(s) && sleep_until(s, th, s.gen_time_ns)) {
+                    return;
+                }
+                break;
+            case GEN_SPLIT:
+                s.gen_parts.clear();
+                split_burst(s.gen_req, [&s](const AXI_REQ& part) { s.gen_parts.push_back(part); });
+                s.gen_part = 0;
+                th.pc = GEN_PUSH;
+                break;
+            case GEN_PUSH:
+                while (s.gen_part < s.gen_parts.size()) {
+                    const AXI_REQ& part = s.gen_parts[s.gen_part];
+                    bool rd = part.type == READ;
+                    RingQueue<queued_req>& fifo = rd ? s.rd_fifo : s.wr_fifo;
+                    if (fifo.size() - leaving(s, rd ? s.ar_claim : s.aw_claim) >= s.queue_depth) {
+                        return;
+                    }
+                    fifo.push_back({ part, s.next_seq++ });
+                    pushed(s, rd ? s.rd_tail : s.wr_tail);
+                    s.gen_part++;
+                }
+                th.pc = GEN_NEXT;
+                break;
+            }
+        }
+    }
+
+    enum { A_GRANT, A_POP, A_READY };
+
+    // ar_process and aw_process
+    void master_addr (uint32_t p, port& s, uint32_t type) {
+        bool rd = type == READ;
+        thread_state& th = s.th[rd ? M_AR : M_AW];
+        while (true) {
+            switch (th.pc) {
+            case A_GRANT:
+                if (!granted(s, type)) {
+                    return;
+                }
+                set(s, rd ? s.ar_busy : s.aw_busy, true);
+                (rd ? s.ar_claim : s.aw_claim) = { s.now_ps + period_ps, true };
+                th.pc = A_POP;
+                return;
+            case A_POP: {
+                RingQueue<queued_req>& fifo = rd ? s.rd_fifo : s.wr_fifo;
+                SlotTable<AXI_REQ>& table = rd ? s.m_ar : s.m_aw;
+                queued_req q = fifo.front();
+                fifo.pop_front();
+                (rd ? s.ar_claim : s.aw_claim).open = false;
+                q.req.id = table.alloc(unseen(s, rd ? s.m_ar_released : s.m_aw_released));
+                q.req.issue_time = now_ns(s);
+                table[q.req.id] = q.req;
+                if (rd) {
+                    next.arid[p] = q.req.id;
+                    next.araddr[p] = q.req.addr;
+                    next.arsize[p] = q.req.size;
+                    next.arlen[p] = q.req.len;
+                    next.arburst[p] = q.req.burst;
+                    next.arvalid[p] = 1;
+                } else {
+                    next.awid[p] = q.req.id;
+                    next.awaddr[p] = q.req.addr;
+                    next.awsize[p] = q.req.size;
+                    next.awlen[p] = q.req.len;
+                    next.awburst[p] = q.req.burst;
+                    next.awvalid[p] = 1;
+                }
+                th.pc = A_READY;
+                return;
+            }
+            case A_READY:
+                if (!(rd ? cur.arready[p] : cur.awready[p])) {
+                    return;
+                }
+                (rd ? next.arvalid[p] : next.awvalid[p]) = 0;
+                set(s, rd ? s.ar_busy : s.aw_busy, false);
+                th.pc = A_GRANT;
+                break;
+            }
+        }
+    }
+
+    void master_ar (uint32_t p, port& s) {
+        master_addr(p, s, READ);
+    }
+
+    void master_aw (uint32_t p, port& s) {
+        master_addr(p, s, WRITE);
+    }
+
+    enum { R_IDLE, R_BEATS };
+
+    void master_r (uint32_t p, port& s) {
+        thread_state& th = s.th[M_R];
+        switch (th.pc) {
+        case R_IDLE:
+            if (!reads_outstanding(s)) {
+                return;
+            }
+            next.rready[p] = 1;
+            th.pc = R_BEATS;
+            return;
+        case R_BEATS: {
+            if (!cur.rvalid[p] || !cur.rlast[p]) {
+                return;
+            }
+            uint32_t id = cur.rid[p];
+            if (!s.m_ar.contains(id)) {
+                throw std::logic_error("cycle engine: R burst with unknown RID");
+            }
+            const AXI_REQ& req = s.m_ar[id];
+            finish(s, req);
+            s.sum.total_read_latency += now_ns(s) - req.issue_time;
+            s.sum.read_bytes += burst_bytes(req);
+            s.sum.read_count++;
+            s.m_ar.release(id);
+            pushed(s, s.m_ar_released);
+            if (!reads_outstanding(s)) {
+                next.rready[p] = 0;
+                th.pc = R_IDLE;
+            }
+            return;
+        }
+        }
+    }
+
+    enum { W_START, W_VALID, W_BEATS };
+
+    void master_w (uint32_t p, port& s) {
+        thread_state& th = s.th[M_W];
+        while (true) {
+            switch (th.pc) {
+            case W_START:
+                th.pc = W_VALID;
+                return;
+            case W_VALID:
+                if (!cur.wvalid[p]) {
+                    return;
+                }
+                s.w_id = cur.wid[p];
+                s.w_total = burst_beats(s.m_aw[s.w_id]);
+                s.w_offset = 0;
+                next.wready[p] = 1;
+                th.pc = W_BEATS;
+                break;
+            case W_BEATS:
+                if (s.w_offset < s.w_total) {
+                    if (cur.wvalid[p] && s.w_offset == s.w_total - 1) {
+                        next.wlast[p] = 1;
+                    }
+                    s.w_offset++;
+                    return;
+                }
+                next.wlast[p] = 0;
+                next.wready[p] = 0;
+                th.pc = W_START;
+                break;
+            }
+        }
+    }
+
+    enum { B_IDLE, B_TAKE };
+
+    void master_b (uint32_t p, port& s) {
+        thread_state& th = s.th[M_B];
+        switch (th.pc) {
+        case B_IDLE:
+            if (!cur.bvalid[p]) {
+                return;
+            }
+            s.b_id = cur.bid[p];
+            next.bready[p] = 1;
+            th.pc = B_TAKE;
+            return;
+        case B_TAKE: {
+            next.bready[p] = 0;
+            if (!s.m_aw.contains(s.b_id)) {
+                throw std::logic_error("cycle engine: B response with unknown BID");
+            }
+            const AXI_REQ& req = s.m_aw[s.b_id];
+            s.sum.total_write_latency += now_ns(s) - req.issue_time;
+            s.sum.written_bytes += burst_bytes(req);
+            s.sum.write_count++;
+            finish(s, req);
+            s.m_aw.release(s.b_id);
+            pushed(s, s.m_aw_released);
+            th.pc = B_IDLE;
+            return;
+        }
+        }
+    }
+
+    // ================= slave: AXISlave's threads
+
+    size_t ar_visible (const port& s) const {
+        return s.s_ar_fifo.size() - unseen(s, s.s_ar_tail);
+    }
+
+    std::vector<uint32_t>::iterator window_end (port& s) {
+        size_t visible = ar_visible(s);
+        return visible > s.reorder_window ? s.s_ar_fifo.begin() + s.reorder_window : s.s_ar_fifo.begin() + visible;
+    }
+
+    bool wlast_taken (uint32_t p, const port& s) const {
+        return s.w_open && cur.wready[p] && cur.wlast[p];
+    }
+
+    void commit_write (port& s) {
+        if (s.w_committed_ps != s.now_ps) {
+            s.w_committed_ps = s.now_ps;
+            s.w_committed_ready = s.dram.access(s.w_req.addr, now_ns(s));
+        }
+    }
+
+    std::vector<uint32_t>::iterator pick_ar (port& s) {
+        auto head = s.s_ar_fifo.begin();
+        if (!s.dram.row_hit_first()) {
+            return head;
+        }
+        for (auto it = head; it != window_end(s); ++it) {
+            if (!s.dram.row_hit(s.s_ar[*it].addr)) {
+                continue;
+            }
+            uint32_t id = s.s_ar[*it].id;
+            if (std::find_if(head, it, [&s, id](uint32_t slot) { return s.s_ar[slot].id == id; }) != it) {
+                continue;
+            }
+            return it;
+        }
+        return head;
+    }
+
+    enum { SA_START, SA_VALID, SA_ROOM, SA_HOLD };
+
+    // ar_process and aw_process
+    void slave_addr (uint32_t p, port& s, uint32_t type) {
+        bool rd = type == READ;
+        thread_state& th = s.th[rd ? S_AR : S_AW];
+        SlotTable<AXI_REQ>& table = rd ? s.s_ar : s.s_aw;
+        tail& released = rd ? s.s_ar_released : s.s_aw_released;
+        while (true) {
+            switch (th.pc) {
+            case SA_START:
+                th.pc = SA_VALID;
+                return;
+            case SA_VALID:
+                if (!(rd ? cur.arvalid[p] : cur.awvalid[p])) {
+                    return;
+                }
+                th.pc = SA_ROOM;
+                break;
+            case SA_ROOM: {
+                if (!slot_free(s, table, released)) {
+                    return;
+                }
+                AXI_REQ req;
+                req.type = type;
+                req.id    = rd ? cur.arid[p] : cur.awid[p];
+                req.addr  = rd ? cur.araddr[p] : cur.awaddr[p];
+                req.size  = rd ? cur.arsize[p] : cur.awsize[p];
+                req.len   = rd ? cur.arlen[p] : cur.awlen[p];
+                req.burst = rd ? cur.arburst[p] : cur.awburst[p];
+                uint32_t slot = table.alloc(unseen(s, released));
+                table[slot] = req;
+                if (rd) {
+                    s.s_ar_fifo.push_back(slot);
+                    pushed(s, s.s_ar_tail);
+                    next.arready[p] = 1;
+                } else {
+                    s.s_aw_fifo.push_back(slot);
+                    pushed(s, s.s_aw_tail);
+                    next.awready[p] = 1;
+                }
+                th.pc = SA_HOLD;
+                return;
+            }
+            case SA_HOLD:
+                if (!(rd ? cur.arvalid[p] : cur.awvalid[p])) {
+                    return;
+                }
+                (rd ? next.arready[p] : next.awready[p]) = 0;
+                th.pc = SA_START;
+                break;
+            }
+        }
+    }
+
+    void slave_ar (uint32_t p, port& s) {
+        slave_addr(p, s, READ);
+    }
+
+    void slave_aw (uint32_t p, port& s) {
+        slave_addr(p, s, WRITE);
+    }
+
+    enum { SR_IDLE, SR_SEND, SR_BEATS };
+
+    void slave_r (uint32_t p, port& s) {
+        thread_state& th = s.th[S_R];
+        while (true) {
+            switch (th.pc) {
+            case SR_IDLE: {
+                if (ar_visible(s) == 0) {
+                    return;
+                }
+                if (wlast_taken(p, s)) {
+                    commit_write(s);
+                }
+                auto pick = pick_ar(s);
+                if (pick != s.s_ar_fifo.begin()) {
+                    s.sum.reorder_count++;
+                }
+                s.sr_slot = *pick;
+                double ready = s.dram.access(s.s_ar[s.sr_slot].addr, now_ns(s));
+                for (auto it = s.s_ar_fifo.begin(); it != window_end(s); ++it) {
+                    if (*it != s.sr_slot) {
+                        s.dram.prepare(s.s_ar[*it].addr, now_ns(s));
+                    }
+                }
+                th.pc = SR_SEND;
+                if (ready > now_ns(s) && sleep_until(s, th, ready)) {
+                    return;
+                }
+                break;
+            }
+            case SR_SEND:
+                next.rid[p] = s.s_ar[s.sr_slot].id;
+                next.rvalid[p] = 1;
+                s.sr_offset = 0;
+                th.pc = SR_BEATS;
+                break;
+            case SR_BEATS: {
+                uint32_t total = burst_beats(s.s_ar[s.sr_slot]);
+                if (s.sr_offset < total) {
+                    if (!cur.rready[p]) {
+                        return;
+                    }
+                    if (s.sr_offset == total - 1) {
+                        next.rlast[p] = 1;
+                    }
+                    s.sr_offset++;
+                    return;
+                }
+                s.s_ar_fifo.erase(std::find(s.s_ar_fifo.begin(), s.s_ar_fifo.end(), s.sr_slot));
+                s.s_ar.release(s.sr_slot);
+                pushed(s, s.s_ar_released);
+                next.rlast[p] = 0;
+                next.rvalid[p] = 0;
+                th.pc = SR_IDLE;
+                break;
+            }
+            }
+        }
+    }
+
+    enum { SW_IDLE, SW_DROP, SW_BEATS };
+
+    void slave_w (uint32_t p, port& s) {
+        thread_state& th = s.th[S_W];
+        while (true) {
+            switch (th.pc) {
+            case SW_IDLE:
+                if (s.s_aw_fifo.size() <= unseen(s, s.s_aw_tail)) {
+                    return;
+                }
+                s.sw_slot = s.s_aw_fifo.front();
+                s.s_aw_fifo.pop_front();
+                s.w_req = s.s_aw[s.sw_slot];
+                next.wid[p] = s.w_req.id;
+                next.wvalid[p] = 1;
+                th.pc = SW_DROP;
+                break;
+            case SW_DROP:
+                if (cur.wready[p]) {
+                    return;
+                }
+                s.w_open = true;
+                th.pc = SW_BEATS;
+                break;
+            case SW_BEATS:
+                if (cur.wready[p] && cur.wlast[p]) {
+                    next.wvalid[p] = 0;
+                    commit_write(s);
+                    s.w_open = false;
+                    s.b_queue.push_back({ s.sw_slot, s.ack_on_commit ? s.w_committed_ready : now_ns(s) });
+                    pushed(s, s.b_tail);
+                    th.pc = SW_IDLE;
+                }
+                return;
+            }
+        }
+    }
+
+    enum { SB_IDLE, SB_SEND, SB_WAIT };
+
+    void slave_b (uint32_t p, port& s) {
+        thread_state& th = s.th[S_B];
+        while (true) {
+            switch (th.pc) {
+            case SB_IDLE: {
+                if (s.b_queue.size() <= unseen(s, s.b_tail)) {
+                    return;
+                }
+                auto due = std::min_element(s.b_queue.begin(), s.b_queue.end() - unseen(s, s.b_tail),
+                                            [](const b_entry& a, const b_entry& b) { return a.ready < b.ready; });
+                s.sb_entry = *due;
+                s.b_queue.erase(due);
+                th.pc = SB_SEND;
+                if (s.sb_entry.ready > now_ns(s) && sleep_until(s, th, s.sb_entry.ready)) {
+                    return;
+                }
+                break;
+            }
+            case SB_SEND:
+                next.bid[p] = s.s_aw[s.sb_entry.slot].id;
+                next.bvalid[p] = 1;
+                th.pc = SB_WAIT;
+                break;
+            case SB_WAIT:
+                if (!cur.bready[p]) {
+                    return;
+                }
+                next.bvalid[p] = 0;
+                s.s_aw.release(s.sb_entry.slot);
+                pushed(s, s.s_aw_released);
+                th.pc = SB_IDLE;
+                return;
+            }
+        }
+    }
+};
+
+#endif
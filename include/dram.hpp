@@ -0,0 +1,221 @@
+#ifndef DRAM_HPP
+#define DRAM_HPP
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <stdexcept>
+#include <cstdint>
+#include <algorithm>
+#include "config.hpp"
+#include "channels/AXICommon.hpp"
+#include "checkpoint.hpp"
+
+// Bank-level DRAM timing model shared by the slaves. All times are ns of
+// simulated time. A row is one dram.row_bytes page; consecutive pages are
+// spread over the banks, banks over the bank groups:
+//   bank = page % banks, group = bank % bank_groups, row = page / banks
+// dram.bank_hash: xor XORs the row's low bits into the bank, so rows that
+// are a power of two of pages apart land in different banks.
+//
+// access() issues the PRE/ACT/RD-or-WR sequence a burst needs and returns
+// when its data is available; prepare() lets the controller open a row in
+// an idle bank ahead of time so activates overlap other banks' transfers.
+class DRAMModel {
+public:
+    uint64_t row_hits = 0;
+    uint64_t row_misses = 0;    // bank was precharged
+    uint64_t row_conflicts = 0; // another row had to be closed first
+    uint64_t early_activates = 0;
+    uint64_t refreshes = 0;
+
+    explicit DRAMModel (const config& cfg)
+        : timing(cfg.dram)
+        , fr_fcfs(cfg.dram.scheduler == "frfcfs")
+        , banks(cfg.dram.banks ? cfg.dram.banks : 1)
+        , bank_groups(cfg.dram.bank_groups ? cfg.dram.bank_groups : 1)
+        , row_bytes(cfg.dram.row_bytes ? cfg.dram.row_bytes : 4096)
+        , bank_xor(cfg.dram.bank_hash == "xor")
+        , bank(banks)
+        , group_last_col(bank_groups, -1e18)
+        , next_refresh(cfg.dram.tREFI_ns)
+    {
+        if (cfg.dram.bank_hash != "none" && cfg.dram.bank_hash != "xor") {
+            throw std::invalid_argument("unknown dram.bank_hash '" + cfg.dram.bank_hash + "'");
+        }
+        if (bank_xor && (banks & (banks - 1))) {
+            throw std::invalid_argument("dram.bank_hash: xor needs a power-of-two dram.banks");
+        }
+    }
+
+    // FR-FCFS: a queued request that hits an open row may go first
+    bool row_hit_first () const {
+        return fr_fcfs;
+    }
+
+    // the same for every address in one row of one bank
+    uint64_t row_key (uint64_t addr) const {
+        return addr / row_bytes;
+    }
+
+    bool row_hit (uint64_t addr) const {
+        location loc = decode(addr);
+        return bank[loc.bank].open_row == loc.row;
+    }
+
+    double access (uint64_t addr, double now) {
+        refresh_until(now);
+        location loc = decode(addr);
+        bank_state& b = bank[loc.bank];
+
+        double t = std::max(now, b.ready);
+        if (b.open_row == loc.row) {
+            row_hits++;
+        } else {
+            if (b.open_row == CLOSED) {
+                row_misses++;
+            } else {
+                row_conflicts++;
+                t = std::max(t, b.act_time + timing.tRAS_ns) + timing.tRP_ns;
+            }
+            b.act_time = t;
+            b.open_row = loc.row;
+            t += timing.tRCD_ns;
+        }
+
+        // column commands: tCCD_L within a bank group, tCCD_S across groups
+        t = std::max({ t, group_last_col[loc.group] + timing.tCCD_L_ns, last_col + timing.tCCD_S_ns });
+        group_last_col[loc.group] = t;
+        last_col = t;
+        b.ready = t;
+        return t + timing.tCAS_ns;
+    }
+
+    void prepare (uint64_t addr, double now) {
+        refresh_until(now);
+        location loc = decode(addr);
+        bank_state& b = bank[loc.bank];
+        if (b.open_row == loc.row || b.ready > now) {
+            return;
+        }
+
+        double t = now;
+        if (b.open_row != CLOSED) {
+            t = std::max(t, b.act_time + timing.tRAS_ns) + timing.tRP_ns;
+        }
+        b.act_time = t;
+        b.open_row = loc.row;
+        b.ready = t + timing.tRCD_ns;
+        early_activates++;
+    }
+
+    // bank state and counters; timing parameters come from the config, so a
+    // restored run may change them but not the bank geometry
+    void save (CheckpointWriter& out) const {
+        out.tag("dram");
+        out.put(row_bytes);
+        out.put(bank_xor);
+        out.put(bank);
+        out.put(group_last_col);
+        out.put(last_col);
+        out.put(next_refresh);
+        out.put(row_hits);
+        out.put(row_misses);
+        out.put(row_conflicts);
+        out.put(early_activates);
+        out.put(refreshes);
+    }
+
+    void restore (CheckpointReader& in) {
+        in.expect("dram");
+        uint64_t saved_row_bytes;
+        bool saved_xor;
+        std::vector<bank_state> saved_bank;
+        std::vector<double> saved_group;
+        in.get(saved_row_bytes);
+        in.get(saved_xor);
+        in.get(saved_bank);
+        in.get(saved_group);
+        if (saved_row_bytes != row_bytes || saved_xor != bank_xor) {
+            throw std::runtime_error("checkpoint dram.row_bytes / dram.bank_hash differ from the config");
+        }
+        if (saved_bank.size() != bank.size() || saved_group.size() != group_last_col.size()) {
+            throw std::runtime_error("checkpoint dram.banks / dram.bank_groups differ from the config");
+        }
+        bank.swap(saved_bank);
+        group_last_col.swap(saved_group);
+        in.get(last_col);
+        in.get(next_refresh);
+        in.get(row_hits);
+        in.get(row_misses);
+        in.get(row_conflicts);
+        in.get(early_activates);
+        in.get(refreshes);
+    }
+
+    void report (std::ostream& os) const {
+        uint64_t accesses = row_hits + row_misses + row_conflicts;
+        os << "[DRAM] accesses: " << accesses
+           << ", row_hits: " << row_hits
+           << ", row_misses: " << row_misses
+           << ", row_conflicts: " << row_conflicts
+           << ", early_activates: " << early_activates
+           << ", refreshes: " << refreshes
+           << ", hit_rate: " << (accesses ? double(row_hits) / accesses : 0) << std::endl;
+    }
+
+private:
+    static constexpr uint64_t CLOSED = UINT64_MAX;
+
+    struct location {
+        uint32_t bank;
+        uint32_t group;
+        uint64_t row;
+    };
+
+    struct bank_state {
+        uint64_t open_row = CLOSED;
+        double act_time = -1e18; // last ACT, for tRAS
+        double ready = 0;        // next command may issue from here
+    };
+
+    decltype(config::dram) timing;
+    bool fr_fcfs;
+    uint32_t banks;
+    uint32_t bank_groups;
+    uint64_t row_bytes;
+    bool bank_xor;
+    std::vector<bank_state> bank;
+    std::vector<double> group_last_col;
+    double last_col = -1e18;
+    double next_refresh;
+
+    location decode (uint64_t addr) const {
+        uint64_t page = addr / row_bytes;
+        location loc;
+        loc.row = page / banks;
+        loc.bank = page % banks;
+        if (bank_xor) {
+            loc.bank = (loc.bank ^ loc.row) & (banks - 1);
+        }
+        loc.group = loc.bank % bank_groups;
+        return loc;
+    }
+
+    // all-bank refresh: every tREFI the banks close and stall for tRFC
+    void refresh_until (double now) {
+        if (timing.tREFI_ns <= 0) {
+            return;
+        }
+        while (now >= next_refresh) {
+            for (bank_state& b : bank) {
+                b.open_row = CLOSED;
+                b.ready = std::max(b.ready, next_refresh + timing.tRFC_ns);
+            }
+            refreshes++;
+            next_refresh += timing.tREFI_ns;
+        }
+    }
+};
+
+#endif
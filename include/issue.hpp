@@ -0,0 +1,88 @@
+#ifndef ISSUE_HPP
+#define ISSUE_HPP
+
+#include <string>
+#include <cstdint>
+#include <stdexcept>
+#include "checkpoint.hpp"
+
+// Decides, once per clock edge, which of a master's read and write queues
+// may send its head burst. rd / wr say whether that head could issue at all
+// (queued, a free ID, no hazard); a direction that cannot is never granted,
+// so a policy that prefers it cannot starve the other one.
+//   parallel     both, AR and AW issue on the same edge
+//   alternate    one per edge, taking turns while both are ready
+//   read_first   writes only on edges without a ready read
+//   write_drain  read_first until write_high writes are queued, then
+//                writes first until at most write_low are left
+class IssueScheduler {
+public:
+    enum policy_t { PARALLEL, ALTERNATE, READ_FIRST, WRITE_DRAIN };
+
+    IssueScheduler (const std::string& name, uint32_t write_high, uint32_t write_low)
+        : policy(parse(name))
+        , write_high(write_high)
+        , write_low(write_low)
+    {
+        if (policy == WRITE_DRAIN && write_low >= write_high) {
+            throw std::invalid_argument("issue scheduler: write_low_watermark must be below write_high_watermark");
+        }
+    }
+
+    void decide (bool rd, bool wr, uint32_t writes_queued, bool& grant_rd, bool& grant_wr) {
+        grant_rd = rd;
+        grant_wr = wr;
+        if (!rd || !wr) {
+            return;
+        }
+        switch (policy) {
+        case PARALLEL:
+            break;
+        case ALTERNATE:
+            grant_rd = last_write;
+            grant_wr = !last_write;
+            last_write = grant_wr;
+            break;
+        case READ_FIRST:
+            grant_wr = false;
+            break;
+        case WRITE_DRAIN:
+            if (draining && writes_queued <= write_low) {
+                draining = false;
+            } else if (!draining && writes_queued >= write_high) {
+                draining = true;
+            }
+            grant_rd = !draining;
+            grant_wr = draining;
+            break;
+        }
+    }
+
+    // the turn and drain state; the policy itself comes from the config
+    void save (CheckpointWriter& out) const {
+        out.put(last_write);
+        out.put(draining);
+    }
+
+    void restore (CheckpointReader& in) {
+        in.get(last_write);
+        in.get(draining);
+    }
+
+private:
+    policy_t policy;
+    uint32_t write_high;
+    uint32_t write_low;
+    bool last_write = true; // alternate: reads go first
+    bool draining = false;
+
+    static policy_t parse (const std::string& name) {
+        if (name == "parallel")    return PARALLEL;
+        if (name == "alternate")   return ALTERNATE;
+        if (name == "read_first")  return READ_FIRST;
+        if (name == "write_drain") return WRITE_DRAIN;
+        throw std::invalid_argument("unknown issue policy: " + name);
+    }
+};
+
+#endif
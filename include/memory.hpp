@@ -0,0 +1,342 @@
+#ifndef MEMORY_HPP
+#define MEMORY_HPP
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "config.hpp"
+#include "channels/AXICommon.hpp"
+#include "channels/AXIBurst.hpp"
+#include "checkpoint.hpp"
+
+// Sparse backing store for the slaves, covering the whole 64-bit address
+// space. Memory is split into 2^page_bits byte pages that are only
+// allocated when first written; reads of untouched pages return zeros
+// without allocating. Pages come out of lazily-faulted anonymous mmap
+// arenas, so resident size follows what the workload actually touches.
+//
+// A raw image file can be mapped in at a page-aligned base. The mapping is
+// MAP_PRIVATE, so writes land in copy-on-write pages and never reach the
+// file. dump() writes everything back out as a raw image with holes where
+// nothing was touched.
+class SparseMemory {
+public:
+    explicit SparseMemory (uint32_t page_bits = 16)
+        : page_bits(page_bits)
+        , page_size(uint64_t(1) << page_bits)
+    {
+    }
+
+    explicit SparseMemory (const config& cfg)
+        : SparseMemory(cfg.memory.page_bits)
+    {
+        if (!cfg.memory.image.empty()) {
+            load_image(cfg.memory.image, cfg.memory.image_base);
+        }
+    }
+
+    SparseMemory (const SparseMemory&) = delete;
+    SparseMemory& operator= (const SparseMemory&) = delete;
+
+    ~SparseMemory () {
+        for (const region& r : arenas) {
+            munmap(r.data, r.size);
+        }
+        for (const region& r : images) {
+            munmap(r.data, r.size);
+        }
+    }
+
+    void load_image (const std::string& path, uint64_t base) {
+        if (base & (page_size - 1)) {
+            throw std::runtime_error("memory image base must be page aligned: " + path);
+        }
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("cannot open memory image: " + path);
+        }
+        struct stat st;
+        fstat(fd, &st);
+        uint64_t size = st.st_size;
+        uint64_t full = size & ~(page_size - 1);
+
+        // whole pages are served straight from the private mapping
+        if (full > 0) {
+            void* data = mmap(nullptr, full, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error("cannot mmap memory image: " + path);
+            }
+            madvise(data, full, MADV_RANDOM);
+            images.push_back({ base, static_cast<uint8_t*>(data), full });
+            for (uint64_t off = 0; off < full; off += page_size) {
+                pages[(base + off) >> page_bits] = static_cast<uint8_t*>(data) + off;
+            }
+        }
+
+        // the partial tail page is copied, mapping past EOF would fault
+        if (size > full) {
+            uint8_t* tail = page(base + full);
+            if (pread(fd, tail, size - full, full) < 0) {
+                close(fd);
+                throw std::runtime_error("cannot read memory image: " + path);
+            }
+        }
+        close(fd);
+        last_pn = UINT64_MAX;
+    }
+
+    // raw image of [base, highest touched byte), untouched pages left as holes
+    void dump (const std::string& path, uint64_t base) const {
+        uint64_t end = base;
+        for (const auto& entry : pages) {
+            uint64_t page_addr = entry.first << page_bits;
+            if (page_addr >= base) {
+                end = std::max(end, page_addr + page_size);
+            }
+        }
+
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            throw std::runtime_error("cannot create memory dump: " + path);
+        }
+        if (ftruncate(fd, end - base) < 0) {
+            close(fd);
+            throw std::runtime_error("cannot size memory dump: " + path);
+        }
+        for (const auto& entry : pages) {
+            uint64_t page_addr = entry.first << page_bits;
+            if (page_addr >= base && pwrite(fd, entry.second, page_size, page_addr - base) < 0) {
+                close(fd);
+                throw std::runtime_error("cannot write memory dump: " + path);
+            }
+        }
+        close(fd);
+    }
+
+    // every touched page, in page number order, as the checkpoint image
+    void save (CheckpointWriter& out) const {
+        std::vector<uint64_t> numbers;
+        numbers.reserve(pages.size());
+        for (const auto& entry : pages) {
+            numbers.push_back(entry.first);
+        }
+        std::sort(numbers.begin(), numbers.end());
+
+        out.tag("memory");
+        out.put(page_bits);
+        out.put(numbers);
+        uint8_t* image = out.image(numbers.size() * page_size);
+        for (size_t i = 0; i < numbers.size(); i++) {
+            std::memcpy(image + i * page_size, pages.at(numbers[i]), page_size);
+        }
+    }
+
+    // replaces the contents with a checkpoint's pages, which are served
+    // copy-on-write from the file like a memory image
+    void restore (CheckpointReader& in) {
+        in.expect("memory");
+        uint32_t bits;
+        in.get(bits);
+        if (bits != page_bits) {
+            throw std::runtime_error("checkpoint memory.page_bits differs from the config");
+        }
+        std::vector<uint64_t> numbers;
+        in.get(numbers);
+        uint64_t size;
+        uint8_t* data = in.map_image(size);
+        if (size != numbers.size() * page_size) {
+            if (data) {
+                munmap(data, size);
+            }
+            throw std::runtime_error("checkpoint memory image does not match its page list");
+        }
+
+        pages.clear();
+        if (data) {
+            madvise(data, size, MADV_RANDOM);
+            images.push_back({ 0, data, size });
+            for (size_t i = 0; i < numbers.size(); i++) {
+                pages[numbers[i]] = data + i * page_size;
+            }
+        }
+        last_pn = UINT64_MAX;
+    }
+
+    uint32_t read32 (uint64_t addr) const {
+        uint32_t word = 0;
+        read(addr, reinterpret_cast<uint8_t*>(&word), sizeof(word));
+        return word;
+    }
+
+    void read (uint64_t addr, uint8_t* dst, uint64_t len) const {
+        while (len > 0) {
+            uint64_t off = addr & (page_size - 1);
+            uint64_t chunk = std::min(len, page_size - off);
+            const uint8_t* p = find(addr);
+            if (p) {
+                std::memcpy(dst, p + off, chunk);
+            } else {
+                std::memset(dst, 0, chunk);
+            }
+            addr += chunk;
+            dst += chunk;
+            len -= chunk;
+        }
+    }
+
+    void write (uint64_t addr, const uint8_t* src, uint64_t len) {
+        while (len > 0) {
+            uint64_t off = addr & (page_size - 1);
+            uint64_t chunk = std::min(len, page_size - off);
+            std::memcpy(page(addr) + off, src, chunk);
+            addr += chunk;
+            src += chunk;
+            len -= chunk;
+        }
+    }
+
+    // one beat under a WSTRB mask
+    void write (uint64_t addr, const uint8_t* src, const AXIStrobe& strb) {
+        if (strb.full()) {
+            write(addr, src, BEAT_BYTES);
+            return;
+        }
+        for (uint32_t lane = 0; lane < BEAT_BYTES; lane++) {
+            if (strb.test(lane)) {
+                page(addr + lane)[(addr + lane) & (page_size - 1)] = src[lane];
+            }
+        }
+    }
+
+    // TLM-style byte enables: 0xFF enables a byte, the pattern repeats
+    // every be_len bytes; no enables writes everything
+    void write (uint64_t addr, const uint8_t* src, uint64_t len, const uint8_t* be, uint32_t be_len) {
+        if (!be || be_len == 0) {
+            write(addr, src, len);
+            return;
+        }
+        for (uint64_t i = 0; i < len; i++) {
+            if (be[i % be_len] == 0xFF) {
+                page(addr + i)[(addr + i) & (page_size - 1)] = src[i];
+            }
+        }
+    }
+
+    // a whole burst to or from a buffer of one BEAT_BYTES slot per beat, as
+    // AXIPayloadPool lays it out; each beat moves the bus-aligned line its
+    // address falls in. be, when given, has one enable per buffer byte
+    void read_burst (const AXI_REQ& req, uint8_t* dst) const {
+        for (uint32_t n = 0; n < burst_beats(req); n++) {
+            read(beat_address(req, n) & ~uint64_t(BEAT_BYTES - 1), dst + (uint64_t(n) << BUS_WIDTH), BEAT_BYTES);
+        }
+    }
+
+    void write_burst (const AXI_REQ& req, const uint8_t* src, const uint8_t* be) {
+        for (uint32_t n = 0; n < burst_beats(req); n++) {
+            uint64_t offset = uint64_t(n) << BUS_WIDTH;
+            write(beat_address(req, n) & ~uint64_t(BEAT_BYTES - 1), src + offset, BEAT_BYTES,
+                  be ? be + offset : nullptr, be ? BEAT_BYTES : 0);
+        }
+    }
+
+    // len bytes at addr in place, nullptr if they straddle a page; untouched
+    // memory reads as a shared zero page
+    const uint8_t* view (uint64_t addr, uint64_t len) const {
+        uint64_t off = addr & (page_size - 1);
+        if (off + len > page_size) {
+            return nullptr;
+        }
+        const uint8_t* p = find(addr);
+        if (!p) {
+            if (zeros.empty()) {
+                zeros.assign(page_size, 0);
+            }
+            return zeros.data() + off;
+        }
+        return p + off;
+    }
+
+    // page holding addr, or nullptr if it was never touched
+    const uint8_t* find (uint64_t addr) const {
+        uint64_t pn = addr >> page_bits;
+        if (pn == last_pn) {
+            return last_page;
+        }
+        auto it = pages.find(pn);
+        if (it == pages.end()) {
+            return nullptr;
+        }
+        last_pn = pn;
+        last_page = it->second;
+        return last_page;
+    }
+
+    // page holding addr, allocated (zeroed) on first touch
+    uint8_t* page (uint64_t addr) {
+        uint64_t pn = addr >> page_bits;
+        if (pn == last_pn) {
+            return last_page;
+        }
+        uint8_t*& p = pages[pn];
+        if (!p) {
+            p = allocate_page();
+        }
+        last_pn = pn;
+        last_page = p;
+        return p;
+    }
+
+    uint64_t resident_pages () const {
+        return pages.size();
+    }
+
+    uint64_t page_bytes () const {
+        return page_size;
+    }
+
+private:
+    static constexpr uint64_t ARENA_PAGES = 64;
+
+    struct region {
+        uint64_t base;
+        uint8_t* data;
+        uint64_t size;
+    };
+
+    uint32_t page_bits;
+    uint64_t page_size;
+    std::unordered_map<uint64_t, uint8_t*> pages; // page number -> data
+    std::vector<region> images;
+    std::vector<region> arenas;
+    uint64_t arena_used = ARENA_PAGES;
+
+    mutable std::vector<uint8_t> zeros; // backs view() of untouched pages
+
+    // one-entry lookup cache: bursts walk the same page beat after beat
+    mutable uint64_t last_pn = UINT64_MAX;
+    mutable uint8_t* last_page = nullptr;
+
+    uint8_t* allocate_page () {
+        if (arena_used == ARENA_PAGES) {
+            uint64_t size = ARENA_PAGES * page_size;
+            void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (data == MAP_FAILED) {
+                throw std::runtime_error("out of memory for sparse pages");
+            }
+            arenas.push_back({ 0, static_cast<uint8_t*>(data), size });
+            arena_used = 0;
+        }
+        return arenas.back().data + (arena_used++) * page_size;
+    }
+};
+
+#endif
@@ -0,0 +1,332 @@
+#ifndef PREFETCH_HPP
+#define PREFETCH_HPP
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+#include "config.hpp"
+#include "dram.hpp"
+#include "write_buffer.hpp"
+#include "channels/AXICommon.hpp"
+#include "channels/AXIBurst.hpp"
+#include "checkpoint.hpp"
+
+// Stream prefetcher in front of a slave's WriteBuffer. Like the write
+// buffer it is a timing model only: the data still comes from
+// SparseMemory, so what a read returns does not depend on it.
+//
+// Every INCR read trains a table of prefetch.streams streams, keyed by
+// ARID or by prefetch.region_bytes region (prefetch.train); a read that
+// lands one stride past a stream's last read continues it whatever its
+// key, and in region mode a read with no stream in its region picks up
+// one in a neighbouring region, so strides up to region_bytes train.
+// Once the same stride has repeated threshold times, each read fetches up
+// to degree bursts of the stream's size ahead, never more than distance
+// strides past the read, into a buffer of prefetch.entries lines, and
+// opens the row of the next one in an idle bank.
+//
+// A read whose lines are all buffered is served after hit_ns, or when the
+// prefetch reading them completes if that is later (a late hit). Writes
+// drop the lines they touch. entries: 0 turns the prefetcher off.
+class Prefetcher {
+public:
+    uint64_t reads = 0;
+    uint64_t hits = 0;          // every line buffered
+    uint64_t late_hits = 0;     // ...but still being read
+    uint64_t prefetches = 0;    // bursts read ahead
+    uint64_t filled_lines = 0;
+    uint64_t useful_lines = 0;  // read by a demand read before leaving
+    uint64_t useless_lines = 0; // evicted unread
+    uint64_t dropped_lines = 0; // written while buffered
+    uint64_t streams_started = 0;
+
+    Prefetcher (const config& cfg, WriteBuffer& write_buffer, DRAMModel& dram)
+        : write_buffer(write_buffer)
+        , dram(dram)
+        , capacity(cfg.prefetch.entries)
+        , line_bytes(cfg.prefetch.line_bytes)
+        , by_region(cfg.prefetch.train == "region")
+        , region_bytes(cfg.prefetch.region_bytes)
+        , threshold(cfg.prefetch.threshold)
+        , degree(cfg.prefetch.degree)
+        , distance(cfg.prefetch.distance)
+        , hit_ns(cfg.prefetch.hit_ns)
+        , streams(cfg.prefetch.streams)
+    {
+        if (!enabled()) {
+            return;
+        }
+        if (line_bytes < BEAT_BYTES || line_bytes > 64 * BEAT_BYTES || (line_bytes & (line_bytes - 1))) {
+            throw std::invalid_argument("prefetch.line_bytes must be a power of two from one beat to 64 beats");
+        }
+        if (cfg.prefetch.train != "id" && cfg.prefetch.train != "region") {
+            throw std::invalid_argument("unknown prefetch.train '" + cfg.prefetch.train + "'");
+        }
+        if (streams.empty() || region_bytes == 0 || degree == 0 || distance < degree) {
+            throw std::invalid_argument("prefetch needs streams, region_bytes and degree > 0 and distance >= degree");
+        }
+        lines.reserve(capacity);
+    }
+
+    bool enabled () const {
+        return capacity > 0;
+    }
+
+    // when the read data is available
+    double read (const AXI_REQ& req, double now) {
+        if (!enabled()) {
+            return write_buffer.read(req, now);
+        }
+        reads++;
+        double ready = now + hit_ns;
+        bool hit = true;
+        uint64_t lo, hi;
+        burst_span(req, lo, hi);
+        for (uint64_t l = lo / line_bytes; hit && l <= (hi - 1) / line_bytes; l++) {
+            auto it = find(l);
+            hit = it != lines.end() && it->line == l;
+            if (hit) {
+                ready = std::max(ready, it->ready);
+            }
+        }
+        if (hit) {
+            hits++;
+            late_hits += ready > now + hit_ns;
+            for (uint64_t l = lo / line_bytes; l <= (hi - 1) / line_bytes; l++) {
+                entry& e = *find(l);
+                useful_lines += !e.used;
+                e.used = true;
+                e.stamp = ++clock;
+            }
+        } else {
+            ready = write_buffer.read(req, now);
+        }
+        train(req, now);
+        return ready;
+    }
+
+    // when the write is committed; buffered lines it touches are dropped
+    double write (const AXI_REQ& req, double now) {
+        if (enabled()) {
+            uint64_t lo, hi;
+            burst_span(req, lo, hi);
+            auto first = find(lo / line_bytes);
+            auto last = find((hi - 1) / line_bytes + 1);
+            dropped_lines += last - first;
+            lines.erase(first, last);
+        }
+        return write_buffer.write(req, now);
+    }
+
+    // streams, buffered lines and counters; parameters come from the config
+    void save (CheckpointWriter& out) const {
+        out.tag("prefetch");
+        out.put(streams);
+        out.put(lines);
+        out.put(clock);
+        out.put(reads);
+        out.put(hits);
+        out.put(late_hits);
+        out.put(prefetches);
+        out.put(filled_lines);
+        out.put(useful_lines);
+        out.put(useless_lines);
+        out.put(dropped_lines);
+        out.put(streams_started);
+    }
+
+    void restore (CheckpointReader& in) {
+        in.expect("prefetch");
+        std::vector<stream> saved_streams;
+        in.get(saved_streams);
+        in.get(lines);
+        if (saved_streams.size() != streams.size() || lines.size() > capacity) {
+            throw std::runtime_error("checkpoint prefetch.streams / prefetch.entries differ from the config");
+        }
+        streams.swap(saved_streams);
+        lines.reserve(capacity);
+        in.get(clock);
+        in.get(reads);
+        in.get(hits);
+        in.get(late_hits);
+        in.get(prefetches);
+        in.get(filled_lines);
+        in.get(useful_lines);
+        in.get(useless_lines);
+        in.get(dropped_lines);
+        in.get(streams_started);
+    }
+
+    // accuracy: prefetched lines a read used; coverage: reads served here
+    void report (std::ostream& os) const {
+        if (!enabled()) {
+            return;
+        }
+        os << "[PF] reads: " << reads
+           << ", hits: " << hits
+           << ", late_hits: " << late_hits
+           << ", coverage: " << (reads ? double(hits) / reads : 0)
+           << ", prefetches: " << prefetches
+           << ", lines: " << filled_lines
+           << ", useful: " << useful_lines
+           << ", useless: " << useless_lines
+           << ", dropped: " << dropped_lines
+           << ", accuracy: " << (filled_lines ? double(useful_lines) / filled_lines : 0)
+           << ", streams: " << streams_started << std::endl;
+    }
+
+private:
+    struct stream {
+        uint64_t key = 0;   // ARID or region
+        int64_t last = -1;  // address of the last read, -1 = free
+        int64_t stride = 0;
+        int64_t ahead = 0;  // address of the last burst prefetched
+        uint32_t confidence = 0;
+        uint64_t stamp = 0; // LRU
+    };
+
+    struct entry {
+        uint64_t line;  // address / line_bytes
+        double ready;   // prefetch read completes
+        uint64_t stamp; // LRU
+        bool used;
+    };
+
+    WriteBuffer& write_buffer;
+    DRAMModel& dram;
+    uint32_t capacity;
+    uint32_t line_bytes;
+    bool by_region;
+    uint64_t region_bytes;
+    uint32_t threshold;
+    uint32_t degree;
+    uint32_t distance;
+    double hit_ns;
+    std::vector<stream> streams;
+    std::vector<entry> lines; // by line, at most capacity
+    uint64_t clock = 0;
+
+    std::vector<entry>::iterator find (uint64_t line) {
+        return std::lower_bound(lines.begin(), lines.end(), line,
+                                [](const entry& e, uint64_t l) { return e.line < l; });
+    }
+
+    stream& stream_of (const AXI_REQ& req) {
+        int64_t addr = req.addr;
+        uint64_t key = by_region ? req.addr / region_bytes : req.id;
+        // a stream this read continues, else the one with its key, else LRU
+        for (stream& s : streams) {
+            if (s.last >= 0 && s.stride != 0 && s.last + s.stride == addr && (by_region || s.key == key)) {
+                s.key = key;
+                return s;
+            }
+        }
+        auto it = std::find_if(streams.begin(), streams.end(),
+                               [key](const stream& s) { return s.last >= 0 && s.key == key; });
+        if (it == streams.end() && by_region) {
+            // a stride of up to a region steps into the next one
+            it = std::find_if(streams.begin(), streams.end(),
+                              [key](const stream& s) { return s.last >= 0 && s.key + 1 >= key && s.key <= key + 1; });
+        }
+        if (it != streams.end()) {
+            it->key = key;
+            return *it;
+        }
+        stream& victim = *std::min_element(streams.begin(), streams.end(),
+                                           [](const stream& a, const stream& b) { return a.stamp < b.stamp; });
+        victim = stream();
+        victim.key = key;
+        streams_started++;
+        return victim;
+    }
+
+    void train (const AXI_REQ& req, double now) {
+        if (req.burst != BURST_INCR) {
+            return;
+        }
+        stream& s = stream_of(req);
+        int64_t addr = req.addr;
+        s.stamp = ++clock;
+        if (s.last >= 0) {
+            int64_t stride = addr - s.last;
+            if (stride != 0 && stride == s.stride) {
+                s.confidence++;
+            } else {
+                s.stride = stride;
+                s.confidence = 0;
+                s.ahead = addr;
+            }
+        }
+        s.last = addr;
+        if (s.stride == 0 || s.confidence < threshold) {
+            return;
+        }
+
+        // the window runs from the read to distance strides past it
+        if ((s.ahead - addr) / s.stride < 0) {
+            s.ahead = addr;
+        }
+        AXI_REQ next = req;
+        for (uint32_t n = 0; n < degree; n++) {
+            int64_t target = s.ahead + s.stride;
+            if ((target - addr) / s.stride > distance || target < 0 || target > UINT32_MAX) {
+                break;
+            }
+            next.addr = static_cast<uint32_t>(target);
+            fill(next, now);
+            s.ahead = target;
+        }
+        int64_t beyond = s.ahead + s.stride;
+        if (beyond >= 0 && beyond <= UINT32_MAX) {
+            dram.prepare(static_cast<uint64_t>(beyond), now);
+        }
+    }
+
+    // reads the burst ahead unless every line of it is buffered already
+    void fill (const AXI_REQ& req, double now) {
+        uint64_t lo, hi;
+        burst_span(req, lo, hi);
+        uint64_t first = lo / line_bytes;
+        uint64_t last = (hi - 1) / line_bytes;
+        bool held = true;
+        for (uint64_t l = first; held && l <= last; l++) {
+            auto it = find(l);
+            held = it != lines.end() && it->line == l;
+        }
+        if (held || last - first + 1 > capacity) {
+            return;
+        }
+
+        prefetches++;
+        double ready = write_buffer.read(req, now);
+        for (uint64_t l = first; l <= last; l++) {
+            auto it = find(l);
+            if (it != lines.end() && it->line == l) {
+                continue;
+            }
+            if (lines.size() == capacity) {
+                evict(first, last);
+                it = find(l);
+            }
+            lines.insert(it, { l, ready, ++clock, false });
+            filled_lines++;
+        }
+    }
+
+    // the least recently used line outside [first, last]
+    void evict (uint64_t first, uint64_t last) {
+        auto victim = lines.end();
+        for (auto it = lines.begin(); it != lines.end(); ++it) {
+            if ((it->line < first || it->line > last) && (victim == lines.end() || it->stamp < victim->stamp)) {
+                victim = it;
+            }
+        }
+        useless_lines += !victim->used;
+        lines.erase(victim);
+    }
+};
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef RECORDER_HPP
+#define RECORDER_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include "async_writer.hpp"
+
+// Binary transaction log: a 16-byte header followed by fixed 24-byte
+// records, one per phase of a burst, little endian. Records of one channel
+// are in time order, channels are interleaved chunk by chunk; txn2json
+// sorts them back into one timeline.
+struct TxnHeader {
+    char magic[8];        // "AXITXN"
+    uint32_t version;     // 1
+    uint32_t record_size; // sizeof(TxnRecord)
+};
+
+struct TxnRecord {
+    uint64_t time_ps;
+    uint32_t addr;   // AR_ISSUE / AW_ISSUE only
+    uint32_t bytes;  // AR_ISSUE / AW_ISSUE only
+    uint32_t id;     // AXI ID as the master issued it
+    uint16_t master;
+    uint8_t  phase;  // TxnRecorder::phase
+    uint8_t  reserved;
+};
+static_assert(sizeof(TxnHeader) == 16, "txn header layout");
+static_assert(sizeof(TxnRecord) == 24, "txn record layout");
+
+// Logs every phase of every burst, as Stats sees them, at a few bytes per
+// phase. Each channel appends to its own preallocated buffer of
+// buffer_records records; a full buffer goes to an AsyncWriter as one
+// chunk and is reused, so the simulation thread only copies records and
+// the file is written on the writer's thread.
+class TxnRecorder {
+public:
+    // in lifecycle order, which breaks ties between phases at one time
+    enum phase { AR_ISSUE, AR_ACCEPT, R_FIRST, R_LAST, AW_ISSUE, AW_ACCEPT, W_FIRST, W_LAST, B_RESP, PHASES };
+    enum channel { AR, R, AW, W, B, CHANNELS };
+
+    static channel channel_of (uint8_t p) {
+        static const channel map[PHASES] = { AR, AR, R, R, AW, AW, W, W, B };
+        return map[p];
+    }
+
+    TxnRecorder (const std::string& path, uint32_t buffer_records)
+        : writer(path, false)
+        , capacity(buffer_records ? buffer_records : 1)
+    {
+        for (std::vector<TxnRecord>& buffer : buffers) {
+            buffer.reserve(capacity);
+        }
+        TxnHeader header;
+        std::memcpy(header.magic, "AXITXN\0", 8);
+        header.version = 1;
+        header.record_size = sizeof(TxnRecord);
+        writer.write(std::string(reinterpret_cast<const char*>(&header), sizeof(header)));
+    }
+
+    TxnRecorder (const TxnRecorder&) = delete;
+    TxnRecorder& operator= (const TxnRecorder&) = delete;
+
+    ~TxnRecorder () {
+        finish();
+    }
+
+    void record (phase p, uint32_t master, uint32_t id, double now, uint32_t addr = 0, uint32_t bytes = 0) {
+        std::vector<TxnRecord>& buffer = buffers[channel_of(p)];
+        TxnRecord rec;
+        rec.time_ps = static_cast<uint64_t>(now * 1000.0 + 0.5);
+        rec.addr = addr;
+        rec.bytes = bytes;
+        rec.id = id;
+        rec.master = static_cast<uint16_t>(master);
+        rec.phase = static_cast<uint8_t>(p);
+        rec.reserved = 0;
+        buffer.push_back(rec);
+        if (buffer.size() == capacity) {
+            flush(buffer);
+        }
+    }
+
+    // hand over what is buffered and close the file
+    void finish () {
+        if (finished) {
+            return;
+        }
+        finished = true;
+        for (std::vector<TxnRecord>& buffer : buffers) {
+            flush(buffer);
+        }
+        writer.close();
+    }
+
+private:
+    AsyncWriter writer;
+    size_t capacity;
+    std::vector<TxnRecord> buffers[CHANNELS];
+    bool finished = false;
+
+    void flush (std::vector<TxnRecord>& buffer) {
+        writer.write(std::string(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(TxnRecord)));
+        buffer.clear();
+    }
+};
+
+#endif
@@ -0,0 +1,131 @@
+#ifndef RNG_HPP
+#define RNG_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+
+// xoshiro256** (Blackman & Vigna). The state is filled by splitmix64, so
+// neighbouring seeds still give unrelated streams. Each consumer owns its
+// generator, seeded from traffic.seed and a stream number, which keeps a run
+// bit-identical however the kernel orders the processes.
+class Xoshiro256 {
+public:
+    // stream numbers: 2 * master for its traffic source, 2 * master + 1 for
+    // its write data
+    static uint64_t source_stream (uint32_t master) { return 2 * uint64_t(master); }
+    static uint64_t data_stream (uint32_t master)   { return 2 * uint64_t(master) + 1; }
+
+    explicit Xoshiro256 (uint64_t seed = 1, uint64_t stream = 0) {
+        uint64_t x = seed ^ (stream * 0xD1B54A32D192ED03ull);
+        for (uint64_t& word : s) {
+            x += 0x9E3779B97F4A7C15ull;
+            uint64_t z = x;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            word = z ^ (z >> 31);
+        }
+    }
+
+    uint64_t next () {
+        uint64_t result = rotl(s[1] * 5, 7) * 9;
+        uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+
+    // uniform in [0, n), multiply-shift (bias below 2^-64 * n)
+    uint64_t below (uint64_t n) {
+        return static_cast<uint64_t>((static_cast<unsigned __int128>(next()) * n) >> 64);
+    }
+
+    // uniform in [min, max]
+    int randn (int min, int max) {
+        return min + static_cast<int>(below(static_cast<uint64_t>(max - min) + 1));
+    }
+
+    // len random bytes, e.g. write data
+    void fill (uint8_t* dst, size_t len) {
+        for (size_t i = 0; i < len; i += sizeof(uint64_t)) {
+            uint64_t word = next();
+            memcpy(dst + i, &word, std::min(len - i, sizeof(word)));
+        }
+    }
+
+    // uniform in [0, 1)
+    double real () {
+        return (next() >> 11) * 0x1.0p-53;
+    }
+
+private:
+    uint64_t s[4];
+
+    static uint64_t rotl (uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+};
+
+// Zipf(n, exponent) over ranks 1..n, rank 1 the most popular. Uses the
+// rejection-inversion method of Hormann & Derflinger: O(1) per sample and
+// no CDF table, so n can span a whole address window.
+class ZipfSampler {
+public:
+    ZipfSampler (uint64_t n, double exponent)
+        : n(std::max<uint64_t>(n, 1))
+        , exponent(exponent)
+    {
+        h_integral_x1 = h_integral(1.5) - 1.0;
+        h_integral_n = h_integral(this->n + 0.5);
+        s = 2.0 - h_integral_inverse(h_integral(2.5) - h(2.0));
+    }
+
+    uint64_t sample (Xoshiro256& rng) const {
+        while (true) {
+            double u = h_integral_n + rng.real() * (h_integral_x1 - h_integral_n);
+            double x = h_integral_inverse(u);
+            double k = std::min(std::max(std::floor(x + 0.5), 1.0), double(n));
+            if (k - x <= s || u >= h_integral(k + 0.5) - h(k)) {
+                return static_cast<uint64_t>(k);
+            }
+        }
+    }
+
+private:
+    uint64_t n;
+    double exponent;
+    double h_integral_x1;
+    double h_integral_n;
+    double s;
+
+    double h (double x) const {
+        return std::exp(-exponent * std::log(x));
+    }
+
+    double h_integral (double x) const {
+        double log_x = std::log(x);
+        return helper2((1.0 - exponent) * log_x) * log_x;
+    }
+
+    double h_integral_inverse (double x) const {
+        double t = std::max(x * (1.0 - exponent), -1.0);
+        return std::exp(helper1(t) * x);
+    }
+
+    // log(1 + x) / x and (exp(x) - 1) / x, stable near 0
+    static double helper1 (double x) {
+        return std::abs(x) > 1e-8 ? std::log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+    }
+
+    static double helper2 (double x) {
+        return std::abs(x) > 1e-8 ? std::expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x * (1.0 / 3.0) * (1.0 + 0.25 * x));
+    }
+};
+
+#endif
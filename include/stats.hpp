@@ -0,0 +1,491 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <systemc>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <cstdint>
+#include "config.hpp"
+#include "channels/AXICommon.hpp"
+#include "checkpoint.hpp"
+#include "completions.hpp"
+#include "recorder.hpp"
+
+// Log-linear latency histogram over ps, 32 sub-buckets per power of two
+// (about 3% resolution). Percentiles report the bucket midpoint, clamped to
+// the exact min/max.
+class LatencyHistogram {
+public:
+    LatencyHistogram () : buckets(BUCKETS, 0) {}
+
+    void add (double ns) {
+        uint64_t v = ns > 0 ? static_cast<uint64_t>(ns * 1000.0 + 0.5) : 0;
+        buckets[index(v)]++;
+        count++;
+        sum += ns;
+        min = count == 1 ? ns : std::min(min, ns);
+        max = count == 1 ? ns : std::max(max, ns);
+    }
+
+    void save (CheckpointWriter& out) const {
+        out.put(buckets);
+        out.put(count);
+        out.put(sum);
+        out.put(min);
+        out.put(max);
+    }
+
+    void restore (CheckpointReader& in) {
+        in.get(buckets);
+        in.get(count);
+        in.get(sum);
+        in.get(min);
+        in.get(max);
+        buckets.resize(BUCKETS, 0);
+    }
+
+    uint64_t samples () const { return count; }
+    double minimum () const { return count ? min : 0; }
+    double maximum () const { return count ? max : 0; }
+    double average () const { return count ? sum / count : 0; }
+
+    double percentile (double p) const {
+        if (count == 0) {
+            return 0;
+        }
+        uint64_t rank = std::max<uint64_t>(static_cast<uint64_t>(p / 100.0 * count + 0.5), 1);
+        uint64_t seen = 0;
+        for (uint32_t i = 0; i < BUCKETS; i++) {
+            seen += buckets[i];
+            if (seen >= rank) {
+                uint32_t shift = i < 2 * SUB ? 0 : i / SUB - 1;
+                uint64_t low = i < 2 * SUB ? i : (uint64_t(i % SUB) + SUB) << shift;
+                double mid = (low + (uint64_t(1) << shift) / 2.0) / 1000.0;
+                return std::min(std::max(mid, min), max);
+            }
+        }
+        return max;
+    }
+
+private:
+    static constexpr uint32_t SUB = 32;
+    static constexpr uint32_t BUCKETS = 60 * SUB;
+
+    std::vector<uint64_t> buckets;
+    uint64_t count = 0;
+    double sum = 0;
+    double min = 0;
+    double max = 0;
+
+    static uint32_t index (uint64_t v) {
+        if (v < 2 * SUB) {
+            return v;
+        }
+        uint32_t shift = 63 - __builtin_clzll(v) - 5;
+        return (shift + 1) * SUB + static_cast<uint32_t>((v >> shift) - SUB);
+    }
+};
+
+// Transaction statistics of one master. Timestamps are kept per ID while a
+// burst is open, in a table of read_ids / write_ids entries indexed by the
+// ID, so the master must hand out IDs below its outstanding limit:
+//   read   issue = ARVALID, accept = ARREADY, first/last = first R beat/RLAST
+//   write  issue = AWVALID, accept = AWREADY, first/last = first W beat/WLAST,
+//          done = B
+// A model that does not expose a point simply never reports it and the
+// matching histogram stays empty. Reads complete at RLAST, writes at B.
+// Completed bytes and the outstanding depth are also binned into window_ns
+// slots for the bandwidth timeline. The timeline has one point per slot and
+// each point is a sliding window over the last window_slots slots: bytes
+// completed in them over their length, and the deepest outstanding count
+// seen. window_slots = 1 gives plain tumbling windows. With a recorder
+// attached, every point is also logged as one TxnRecorder record.
+class Stats {
+public:
+    enum channel { AR, R, AW, W, B, CHANNELS };
+    enum latency { AR_ACCEPT, R_FIRST, R_LAST, AW_ACCEPT, W_FIRST, W_LAST, B_RESP, LATENCIES };
+
+    uint64_t stall_cycles[CHANNELS] = {}; // VALID high, READY low
+    CompletionLog* completion_log = nullptr; // stats.completions, pin model
+
+    Stats (double window_ns, uint32_t window_slots, uint32_t read_ids, uint32_t write_ids)
+        : window_ns(window_ns > 0 ? window_ns : 1000)
+        , window_slots(std::max<uint32_t>(window_slots, 1))
+        , open{ std::vector<txn_times>(std::max<uint32_t>(read_ids, 1)), std::vector<txn_times>(std::max<uint32_t>(write_ids, 1)) }
+    {}
+
+    void issue (uint32_t type, uint32_t id, double now, uint64_t bytes, uint32_t addr) {
+        if (id >= open[type].size()) {
+            throw std::out_of_range("Stats: ID beyond the master's outstanding limit");
+        }
+        txn_times& t = open[type][id];
+        t.issue = now;
+        t.bytes = bytes;
+        t.open = true;
+        set_outstanding(type, outstanding[type] + 1, now);
+        if (recorder) {
+            recorder->record(type == READ ? TxnRecorder::AR_ISSUE : TxnRecorder::AW_ISSUE, recorder_master, id, now, addr, static_cast<uint32_t>(bytes));
+        }
+    }
+
+    void accept (uint32_t type, uint32_t id, double now) {
+        mark(type, id, now, type == READ ? AR_ACCEPT : AW_ACCEPT);
+        log(type == READ ? TxnRecorder::AR_ACCEPT : TxnRecorder::AW_ACCEPT, id, now);
+    }
+
+    void first_beat (uint32_t type, uint32_t id, double now) {
+        mark(type, id, now, type == READ ? R_FIRST : W_FIRST);
+        log(type == READ ? TxnRecorder::R_FIRST : TxnRecorder::W_FIRST, id, now);
+    }
+
+    void last_beat (uint32_t type, uint32_t id, double now) {
+        mark(type, id, now, type == READ ? R_LAST : W_LAST);
+        log(type == READ ? TxnRecorder::R_LAST : TxnRecorder::W_LAST, id, now);
+        if (type == READ) {
+            complete(READ, id, now);
+        }
+    }
+
+    void response (uint32_t id, double now) {
+        mark(WRITE, id, now, B_RESP);
+        log(TxnRecorder::B_RESP, id, now);
+        complete(WRITE, id, now);
+    }
+
+    // log every point from now on to recorder, as master `index`
+    void record_to (TxnRecorder* r, uint32_t index) {
+        recorder = r;
+        recorder_master = index;
+    }
+
+    void stall (channel ch, uint64_t cycles = 1) {
+        stall_cycles[ch] += cycles;
+    }
+
+    uint64_t completions () const {
+        return completed[READ] + completed[WRITE];
+    }
+
+    // slowest burst so far, issue to RLAST or B
+    double worst_latency () const {
+        return std::max(hist[R_LAST].maximum(), hist[B_RESP].maximum());
+    }
+
+    // summary, latencies and the bandwidth timeline as one JSON object
+    void write_json (std::ostream& os, double now) const {
+        os << "{\"completed\": {\"read\": " << completed[READ] << ", \"write\": " << completed[WRITE] << "}"
+           << ", \"bytes\": {\"read\": " << bytes[READ] << ", \"write\": " << bytes[WRITE] << "}"
+           << ", \"gbps\": {\"read\": " << (now > 0 ? bytes[READ] / now : 0)
+           << ", \"write\": " << (now > 0 ? bytes[WRITE] / now : 0) << "}";
+
+        os << ", \"latency_ns\": {";
+        for (uint32_t l = 0; l < LATENCIES; l++) {
+            const LatencyHistogram& h = hist[l];
+            os << (l ? ", " : "") << "\"" << LATENCY_NAMES[l] << "\": {\"count\": " << h.samples()
+               << ", \"min\": " << h.minimum() << ", \"avg\": " << h.average()
+               << ", \"p50\": " << h.percentile(50) << ", \"p99\": " << h.percentile(99)
+               << ", \"max\": " << h.maximum() << "}";
+        }
+        os << "}";
+
+        os << ", \"outstanding\": {";
+        for (uint32_t type = READ; type <= WRITE; type++) {
+            os << (type ? ", " : "") << "\"" << (type == READ ? "read" : "write") << "\": {\"max\": " << max_outstanding[type]
+               << ", \"avg\": " << average_outstanding(type, now) << "}";
+        }
+        os << "}";
+
+        os << ", \"stall_cycles\": {";
+        for (uint32_t c = 0; c < CHANNELS; c++) {
+            os << (c ? ", " : "") << "\"" << CHANNEL_NAMES[c] << "\": " << stall_cycles[c];
+        }
+        os << "}";
+
+        os << ", \"window_ns\": " << window_ns << ", \"window_slots\": " << window_slots << ", \"timeline\": [";
+        for (size_t w = 0; w < windows.size(); w++) {
+            window s = sliding(w);
+            double span = span_ns(w);
+            os << (w ? ", " : "") << "{\"t\": " << (w + 1) * window_ns
+               << ", \"read_gbps\": " << s.bytes[READ] / span << ", \"write_gbps\": " << s.bytes[WRITE] / span
+               << ", \"read_outstanding\": " << s.max_outstanding[READ] << ", \"write_outstanding\": " << s.max_outstanding[WRITE] << "}";
+        }
+        os << "]}";
+    }
+
+    // one row per latency metric, prefixed by export time and master name
+    void write_csv (std::ostream& os, const std::string& name, double now) const {
+        for (uint32_t l = 0; l < LATENCIES; l++) {
+            const LatencyHistogram& h = hist[l];
+            os << now << "," << name << "," << LATENCY_NAMES[l] << "," << h.samples() << "," << h.minimum() << ","
+               << h.average() << "," << h.percentile(50) << "," << h.percentile(99) << "," << h.maximum() << "\n";
+        }
+    }
+
+    void write_timeline_csv (std::ostream& os, const std::string& name) const {
+        for (size_t w = 0; w < windows.size(); w++) {
+            window s = sliding(w);
+            double span = span_ns(w);
+            os << name << "," << (w + 1) * window_ns << "," << s.bytes[READ] / span << "," << s.bytes[WRITE] / span << ","
+               << s.max_outstanding[READ] << "," << s.max_outstanding[WRITE] << "\n";
+        }
+    }
+
+    // everything, so a restored run reports over the whole run as if it had
+    // not been interrupted
+    void save (CheckpointWriter& out) const {
+        out.tag("stats");
+        out.put(window_ns);
+        out.put(stall_cycles);
+        out.put(open[READ]);
+        out.put(open[WRITE]);
+        for (const LatencyHistogram& h : hist) {
+            h.save(out);
+        }
+        out.put(completed);
+        out.put(bytes);
+        out.put(windows);
+        out.put(outstanding);
+        out.put(max_outstanding);
+        out.put(outstanding_area);
+        out.put(outstanding_since);
+    }
+
+    void restore (CheckpointReader& in) {
+        in.expect("stats");
+        double saved_window_ns;
+        in.get(saved_window_ns);
+        if (saved_window_ns != window_ns) {
+            throw std::runtime_error("checkpoint stats.window_ns differs from the config");
+        }
+        in.get(stall_cycles);
+        for (uint32_t type = READ; type <= WRITE; type++) {
+            size_t ids = open[type].size();
+            in.get(open[type]);
+            if (open[type].size() != ids) {
+                throw std::runtime_error("checkpoint stats ID table does not match the configured outstanding depth");
+            }
+        }
+        for (LatencyHistogram& h : hist) {
+            h.restore(in);
+        }
+        in.get(completed);
+        in.get(bytes);
+        in.get(windows);
+        in.get(outstanding);
+        in.get(max_outstanding);
+        in.get(outstanding_area);
+        in.get(outstanding_since);
+    }
+
+    static constexpr const char* CSV_HEADER = "time_ns,master,metric,count,min_ns,avg_ns,p50_ns,p99_ns,max_ns";
+    static constexpr const char* TIMELINE_CSV_HEADER = "master,window_end_ns,read_gbps,write_gbps,read_outstanding,write_outstanding";
+
+private:
+    static constexpr const char* LATENCY_NAMES[LATENCIES] = { "ar_accept", "r_first", "r_last", "aw_accept", "w_first", "w_last", "b_resp" };
+    static constexpr const char* CHANNEL_NAMES[CHANNELS] = { "ar", "r", "aw", "w", "b" };
+
+    struct txn_times {
+        double issue = 0;
+        uint64_t bytes = 0;
+        bool open = false;
+    };
+
+    struct window {
+        uint64_t bytes[2] = {};
+        uint32_t max_outstanding[2] = {};
+    };
+
+    double window_ns;
+    uint32_t window_slots;
+    std::vector<txn_times> open[2]; // by READ / WRITE, indexed by id
+    LatencyHistogram hist[LATENCIES];
+    uint64_t completed[2] = {};
+    uint64_t bytes[2] = {};
+    std::vector<window> windows;
+
+    TxnRecorder* recorder = nullptr;
+    uint32_t recorder_master = 0;
+
+    uint32_t outstanding[2] = {};
+    uint32_t max_outstanding[2] = {};
+    double outstanding_area[2] = {}; // depth integrated over ns
+    double outstanding_since[2] = {};
+
+    void mark (uint32_t type, uint32_t id, double now, latency l) {
+        if (id < open[type].size() && open[type][id].open) {
+            hist[l].add(now - open[type][id].issue);
+        }
+    }
+
+    void log (TxnRecorder::phase p, uint32_t id, double now) {
+        if (recorder) {
+            recorder->record(p, recorder_master, id, now);
+        }
+    }
+
+    void complete (uint32_t type, uint32_t id, double now) {
+        if (id >= open[type].size() || !open[type][id].open) {
+            return;
+        }
+        txn_times& t = open[type][id];
+        completed[type]++;
+        bytes[type] += t.bytes;
+        if (completion_log) {
+            completion_log->record(type, id, t.bytes, t.issue, now);
+        }
+        slot(now).bytes[type] += t.bytes;
+        t.open = false;
+        set_outstanding(type, outstanding[type] - 1, now);
+    }
+
+    void set_outstanding (uint32_t type, uint32_t depth, double now) {
+        // loosely-timed masters may report slightly out of order
+        outstanding_area[type] += outstanding[type] * std::max(now - outstanding_since[type], 0.0);
+        outstanding_since[type] = std::max(now, outstanding_since[type]);
+        outstanding[type] = depth;
+        max_outstanding[type] = std::max(max_outstanding[type], depth);
+        window& s = slot(now);
+        s.max_outstanding[type] = std::max(s.max_outstanding[type], depth);
+    }
+
+    double average_outstanding (uint32_t type, double now) const {
+        double area = outstanding_area[type] + outstanding[type] * (now - outstanding_since[type]);
+        return now > 0 ? area / now : 0;
+    }
+
+    // slots w - window_slots + 1 .. w folded into one, for the timeline
+    window sliding (size_t w) const {
+        window s;
+        for (size_t i = w + 1 - std::min<size_t>(w + 1, window_slots); i <= w; i++) {
+            for (uint32_t type = READ; type <= WRITE; type++) {
+                s.bytes[type] += windows[i].bytes[type];
+                s.max_outstanding[type] = std::max(s.max_outstanding[type], windows[i].max_outstanding[type]);
+            }
+        }
+        return s;
+    }
+
+    // length of sliding(w); shorter at the start of the run
+    double span_ns (size_t w) const {
+        return std::min<size_t>(w + 1, window_slots) * window_ns;
+    }
+
+    window& slot (double now) {
+        size_t w = static_cast<size_t>(now / window_ns);
+        if (w >= windows.size()) {
+            // a window with no events inherits the depth still in flight
+            window carry;
+            carry.max_outstanding[READ] = outstanding[READ];
+            carry.max_outstanding[WRITE] = outstanding[WRITE];
+            windows.resize(w + 1, carry);
+        }
+        return windows[w];
+    }
+};
+
+// Writes every registered Stats at stats.interval_ns and once more when
+// finish() is called after sc_start returns:
+//   <output>.json           latest snapshot, rewritten on every export
+//   <output>.csv            latency rows appended on every export
+//   <output>_timeline.csv   bandwidth/outstanding windows, rewritten
+// The JSON also carries the kernel's own cost: delta cycles and host
+// seconds spent in simulation, for `make bench`.
+// An empty stats.output disables export. stats.transactions attaches one
+// TxnRecorder to every registered Stats, closed by finish().
+SC_MODULE (StatsExporter) {
+    SC_HAS_PROCESS(StatsExporter);
+    StatsExporter(sc_core::sc_module_name name, const config& cfg)
+        : sc_module(name)
+        , output(cfg.stats.output)
+        , interval_ns(cfg.stats.interval_ns)
+    {
+        if (!output.empty()) {
+            std::ofstream csv(output + ".csv");
+            if (!csv) {
+                throw std::runtime_error("cannot create stats file: " + output + ".csv");
+            }
+            csv << Stats::CSV_HEADER << "\n";
+        }
+        if (!cfg.stats.transactions.empty()) {
+            recorder.reset(new TxnRecorder(cfg.stats.transactions, cfg.stats.transaction_buffer));
+        }
+        if (!output.empty() && interval_ns > 0) {
+            SC_THREAD(periodic_process);
+        }
+    }
+
+    // the master index in the transaction log is the order of add()
+    void add (const std::string& name, Stats& stats) {
+        if (recorder) {
+            stats.record_to(recorder.get(), static_cast<uint32_t>(entries.size()));
+        }
+        entries.push_back({ name, &stats });
+    }
+
+    void finish (double now) {
+        export_all(now);
+        if (recorder) {
+            recorder->finish();
+        }
+    }
+
+private:
+    struct entry {
+        std::string name;
+        const Stats* stats;
+    };
+
+    std::string output;
+    double interval_ns;
+    std::vector<entry> entries;
+    std::unique_ptr<TxnRecorder> recorder;
+    std::chrono::steady_clock::time_point host_start;
+
+    // elaboration is not counted
+    void start_of_simulation () override {
+        host_start = std::chrono::steady_clock::now();
+    }
+
+    void periodic_process () {
+        while (true) {
+            wait(interval_ns, sc_core::SC_NS);
+            export_all(sc_core::sc_time_stamp().to_seconds() * 1e9);
+        }
+    }
+
+    void export_all (double now) {
+        if (output.empty()) {
+            return;
+        }
+
+        std::ofstream json(output + ".json");
+        json << "{\"time_ns\": " << now << ", \"masters\": {";
+        for (size_t i = 0; i < entries.size(); i++) {
+            json << (i ? ", " : "") << "\"" << entries[i].name << "\": ";
+            entries[i].stats->write_json(json, now);
+        }
+        double host_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - host_start).count();
+        json << "}, \"kernel\": {\"delta_cycles\": " << sc_core::sc_delta_count()
+             << ", \"host_seconds\": " << host_seconds
+             << ", \"sim_ns_per_host_second\": " << (host_seconds > 0 ? now / host_seconds : 0) << "}}\n";
+
+        std::ofstream csv(output + ".csv", std::ios::app);
+        for (const entry& e : entries) {
+            e.stats->write_csv(csv, e.name, now);
+        }
+
+        std::ofstream timeline(output + "_timeline.csv");
+        timeline << Stats::TIMELINE_CSV_HEADER << "\n";
+        for (const entry& e : entries) {
+            e.stats->write_timeline_csv(timeline, e.name);
+        }
+    }
+};
+
+#endif
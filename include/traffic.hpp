@@ -0,0 +1,431 @@
+#ifndef TRAFFIC_HPP
+#define TRAFFIC_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <cctype>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include "config.hpp"
+#include "channels/AXICommon.hpp"
+#include "channels/AXIBurst.hpp"
+#include "rng.hpp"
+#include "checkpoint.hpp"
+
+// Where a master's requests come from. next() fills type/addr/size/len/burst
+// (and id, which masters treat as informational: they issue their own
+// unique AXI ids) plus the simulated time the request should be injected
+// at, and returns false once the source is exhausted. Masters pass every
+// request through split_burst, so an INCR request may be longer than AXI
+// allows or cross 4KB. save()/restore() carry the position in the stream
+// through a checkpoint.
+class TrafficSource {
+public:
+    virtual ~TrafficSource() {}
+    virtual bool next (AXI_REQ& req, double& time_ns) = 0;
+    virtual void save (CheckpointWriter& out) const = 0;
+    virtual void restore (CheckpointReader& in) = 0;
+};
+
+// The original generator: uniform read/write mix to the base address of a
+// randomly chosen target, one request every 2.5 ns. Bursts are full-width
+// INCR of 1, 2, 4 or 8 times 1 to 32 beats, the volumes the old 128B to 1KB
+// "sizes" stood for.
+class RandomSource : public TrafficSource {
+public:
+    explicit RandomSource (const std::vector<uint64_t>& bases = { 0 }, uint64_t seed = 1, uint64_t stream = 0)
+        : bases(bases)
+        , rng(seed, stream)
+    {
+    }
+
+    bool next (AXI_REQ& req, double& time_ns) override {
+        req.type = randn(READ, WRITE);
+        req.id   = 0;
+        req.addr = bases[randn(0, bases.size() - 1)];
+        req.size = BUS_WIDTH;
+        uint32_t scale = 1u << randn(0, 3);
+        req.len  = scale * (randn(0, 31) + 1) - 1;
+        req.burst = BURST_INCR;
+        time_ns = now;
+        now += 2.5;
+        return true;
+    }
+
+    void save (CheckpointWriter& out) const override {
+        out.tag("random");
+        out.put(rng);
+        out.put(now);
+    }
+
+    void restore (CheckpointReader& in) override {
+        in.expect("random");
+        in.get(rng);
+        in.get(now);
+    }
+
+private:
+    std::vector<uint64_t> bases;
+    Xoshiro256 rng;
+    double now = 0;
+
+    int randn(int min, int max) {
+        return rng.randn(min, max);
+    }
+};
+
+// Synthetic traffic fully determined by a traffic_pattern and a seed. Every
+// burst is pattern size/len/burst, aligned to its own length, inside the
+// window [base, base + range); a WRAP burst then starts at a random beat of
+// its window, like a critical-word-first line fill:
+//   sequential  back-to-back bursts, wrapping at the end of the window
+//   strided     burst start advances by stride bytes, wrapping likewise
+//   uniform     uniformly random burst slot
+//   hotspot     hot_probability of the bursts land in the first hot_fraction
+//   zipf        burst slot by popularity rank, Zipf(zipf_exponent)
+// read_ratio sets the read/write mix. Bursts are injected every interval_ns,
+// or with exponentially distributed gaps of that mean when poisson is set.
+class PatternSource : public TrafficSource {
+public:
+    PatternSource (const traffic_pattern& p, uint64_t seed, uint64_t stream)
+        : p(p)
+        , rng(seed, stream)
+        , burst_bytes((uint64_t(1) << p.size) * (p.len + 1))
+        , slots(std::max<uint64_t>(p.range / burst_bytes, 1))
+        , zipf(slots, p.zipf_exponent)
+        , burst(burst_type(p.burst))
+    {
+        if (p.type != "sequential" && p.type != "strided" && p.type != "uniform"
+            && p.type != "hotspot" && p.type != "zipf") {
+            throw std::invalid_argument("unknown traffic pattern: " + p.type);
+        }
+        AXI_REQ probe;
+        probe.addr = 0;
+        probe.size = p.size;
+        probe.len = p.len;
+        probe.burst = burst;
+        if (const char* error = burst_error(probe)) {
+            if (burst != BURST_INCR || p.size > BUS_WIDTH) {
+                throw std::invalid_argument(std::string("traffic pattern burst: ") + error);
+            }
+        }
+    }
+
+    bool next (AXI_REQ& req, double& time_ns) override {
+        req.type = rng.real() < p.read_ratio ? READ : WRITE;
+        req.id   = 0;
+        req.addr = p.base + offset();
+        req.size = p.size;
+        req.len  = p.len;
+        req.burst = burst;
+        if (burst == BURST_WRAP) {
+            req.addr += rng.below(p.len + 1) << p.size;
+        }
+        time_ns = now;
+        now += p.poisson ? -std::log(1.0 - rng.real()) * p.interval_ns : p.interval_ns;
+        return true;
+    }
+
+    void save (CheckpointWriter& out) const override {
+        out.tag("pattern");
+        out.put(rng);
+        out.put(cursor);
+        out.put(now);
+    }
+
+    void restore (CheckpointReader& in) override {
+        in.expect("pattern");
+        in.get(rng);
+        in.get(cursor);
+        in.get(now);
+    }
+
+private:
+    traffic_pattern p;
+    Xoshiro256 rng;
+    uint64_t burst_bytes;
+    uint64_t slots; // burst-sized positions in the window
+    ZipfSampler zipf;
+    uint32_t burst;
+    uint64_t cursor = 0;
+    double now = 0;
+
+    uint64_t offset () {
+        if (p.type == "sequential" || p.type == "strided") {
+            uint64_t off = cursor;
+            cursor += p.type == "sequential" ? burst_bytes : p.stride;
+            if (cursor + burst_bytes > p.range) {
+                cursor = 0;
+            }
+            return off;
+        }
+        if (p.type == "uniform") {
+            return rng.below(slots) * burst_bytes;
+        }
+        if (p.type == "hotspot") {
+            uint64_t hot = std::max<uint64_t>(slots * p.hot_fraction, 1);
+            return rng.below(rng.real() < p.hot_probability ? hot : slots) * burst_bytes;
+        }
+        return (zipf.sample(rng) - 1) * burst_bytes;
+    }
+};
+
+// Binary trace layout: a 16-byte header followed by fixed 24-byte records,
+// all little endian. Version 1 records had a 16-bit len in place of len and
+// burst; they still load, as INCR bursts.
+struct TraceHeader {
+    char magic[8];        // "AXITRACE"
+    uint32_t version;     // 2
+    uint32_t record_size; // sizeof(TraceRecord)
+};
+
+struct TraceRecord {
+    uint64_t timestamp_ps;
+    uint64_t addr;
+    uint32_t id;
+    uint8_t  type;  // READ / WRITE
+    uint8_t  size;  // AxSIZE
+    uint8_t  len;   // AxLEN
+    uint8_t  burst; // AxBURST
+};
+static_assert(sizeof(TraceHeader) == 16, "trace header layout");
+static_assert(sizeof(TraceRecord) == 24, "trace record layout");
+
+// Streams a captured trace in constant memory: binary traces are read in
+// fixed chunks with pread, CSV traces line by line. A file is treated as
+// CSV when it does not start with the binary magic. CSV columns are
+//   timestamp_ns, R|W, addr, size, len[, id[, FIXED|INCR|WRAP]]
+// with addr in decimal or 0x-hex and INCR as the default burst; blank lines
+// and lines starting with '#' (or a non-numeric header line) are skipped.
+class TraceSource : public TrafficSource {
+public:
+    explicit TraceSource (const std::string& path) : path(path) {
+        fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("cannot open trace: " + path);
+        }
+
+        TraceHeader header;
+        binary = pread(fd, &header, sizeof(header), 0) == sizeof(header)
+              && std::memcmp(header.magic, "AXITRACE", 8) == 0;
+        if (binary) {
+            if ((header.version != 1 && header.version != 2) || header.record_size != sizeof(TraceRecord)) {
+                throw std::runtime_error("unsupported trace version: " + path);
+            }
+            legacy = header.version == 1;
+            offset = sizeof(header);
+            chunk.resize(CHUNK_RECORDS);
+            posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        } else {
+            close(fd);
+            fd = -1;
+            csv.open(path);
+            if (!csv) {
+                throw std::runtime_error("cannot open trace: " + path);
+            }
+        }
+    }
+
+    ~TraceSource () {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    bool next (AXI_REQ& req, double& time_ns) override {
+        if (!binary) {
+            return next_csv(req, time_ns);
+        }
+        TraceRecord rec;
+        if (!next_binary(rec)) {
+            return false;
+        }
+        req.type = rec.type;
+        req.id   = rec.id;
+        req.addr = rec.addr;
+        req.size = rec.size;
+        req.len  = rec.len;
+        req.burst = rec.burst;
+        if (legacy) {
+            uint16_t len16;
+            std::memcpy(&len16, &rec.len, sizeof(len16));
+            req.len = len16;
+            req.burst = BURST_INCR;
+        }
+        time_ns = rec.timestamp_ps / 1000.0;
+        return true;
+    }
+
+    // file offset of the next record or line
+    void save (CheckpointWriter& out) const override {
+        out.tag("trace");
+        uint64_t at = binary ? offset - (count - pos) * sizeof(TraceRecord) : csv_offset;
+        out.put(at);
+        out.put(line_no);
+    }
+
+    void restore (CheckpointReader& in) override {
+        in.expect("trace");
+        uint64_t at;
+        in.get(at);
+        in.get(line_no);
+        if (binary) {
+            offset = at;
+            pos = count = 0;
+        } else {
+            csv_offset = at;
+            csv.clear();
+            csv.seekg(at);
+        }
+    }
+
+    // CSV -> binary, for traces replayed more than once
+    static void import_csv (const std::string& csv_path, const std::string& trace_path) {
+        TraceSource in(csv_path);
+        std::ofstream out(trace_path, std::ios::binary);
+        if (!out) {
+            throw std::runtime_error("cannot create trace: " + trace_path);
+        }
+        TraceHeader header;
+        std::memcpy(header.magic, "AXITRACE", 8);
+        header.version = 2;
+        header.record_size = sizeof(TraceRecord);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        AXI_REQ req;
+        double time_ns;
+        while (in.next(req, time_ns)) {
+            // records hold an 8-bit AxLEN, so long INCR bursts are stored split
+            split_burst(req, [&](const AXI_REQ& part) {
+                TraceRecord rec;
+                rec.timestamp_ps = static_cast<uint64_t>(time_ns * 1000.0 + 0.5);
+                rec.addr  = part.addr;
+                rec.id    = part.id;
+                rec.type  = part.type;
+                rec.size  = part.size;
+                rec.len   = part.len;
+                rec.burst = part.burst;
+                out.write(reinterpret_cast<const char*>(&rec), sizeof(rec));
+            });
+        }
+    }
+
+private:
+    static constexpr size_t CHUNK_RECORDS = 16384; // 384KB read buffer
+
+    std::string path;
+    int fd = -1;
+    bool binary = false;
+    bool legacy = false; // version 1 records
+
+    std::vector<TraceRecord> chunk;
+    size_t pos = 0;
+    size_t count = 0;
+    uint64_t offset = 0;
+
+    std::ifstream csv;
+    uint64_t csv_offset = 0; // bytes consumed, for checkpoints
+    uint64_t line_no = 0;
+
+    bool next_binary (TraceRecord& rec) {
+        if (pos == count) {
+            ssize_t bytes = pread(fd, chunk.data(), chunk.size() * sizeof(TraceRecord), offset);
+            if (bytes <= 0) {
+                return false;
+            }
+            offset += bytes;
+            count = bytes / sizeof(TraceRecord);
+            pos = 0;
+            if (count == 0) {
+                return false;
+            }
+        }
+        rec = chunk[pos++];
+        return true;
+    }
+
+    bool next_csv (AXI_REQ& req, double& time_ns) {
+        std::string line;
+        while (std::getline(csv, line)) {
+            line_no++;
+            csv_offset += line.size() + 1;
+            size_t start = line.find_first_not_of(" \t\r");
+            if (start == std::string::npos || line[start] == '#') {
+                continue;
+            }
+            if (!std::isdigit(static_cast<unsigned char>(line[start])) && line[start] != '.') {
+                continue; // header row
+            }
+
+            std::vector<std::string> fields;
+            std::stringstream ss(line);
+            std::string field;
+            while (std::getline(ss, field, ',')) {
+                fields.push_back(field);
+            }
+            if (fields.size() < 5) {
+                throw std::runtime_error(path + ":" + std::to_string(line_no) + ": expected timestamp,type,addr,size,len[,id[,burst]]");
+            }
+
+            size_t t = fields[1].find_first_not_of(" \t");
+            char type = t == std::string::npos ? ' ' : std::toupper(fields[1][t]);
+            if (type != 'R' && type != 'W') {
+                throw std::runtime_error(path + ":" + std::to_string(line_no) + ": type must be R or W");
+            }
+
+            uint64_t timestamp_ps = static_cast<uint64_t>(std::strtod(fields[0].c_str(), nullptr) * 1000.0 + 0.5);
+            time_ns = timestamp_ps / 1000.0;
+            req.type = type == 'R' ? READ : WRITE;
+            req.addr = std::strtoull(fields[2].c_str(), nullptr, 0);
+            req.size = std::strtoul(fields[3].c_str(), nullptr, 0);
+            req.len  = std::strtoul(fields[4].c_str(), nullptr, 0);
+            req.id   = fields.size() > 5 ? std::strtoul(fields[5].c_str(), nullptr, 0) : 0;
+            req.burst = BURST_INCR;
+            if (fields.size() > 6) {
+                std::string burst = fields[6];
+                burst.erase(0, burst.find_first_not_of(" \t"));
+                burst.erase(burst.find_last_not_of(" \t\r") + 1);
+                try {
+                    req.burst = burst_type(burst);
+                } catch (const std::invalid_argument& e) {
+                    throw std::runtime_error(path + ":" + std::to_string(line_no) + ": " + e.what());
+                }
+            }
+            return true;
+        }
+        return false;
+    }
+};
+
+// Source for master `index`; a "{master}" in traffic.trace is replaced by
+// the index so each master of a bus can replay its own capture. Generated
+// traffic is seeded per master from traffic.seed.
+inline std::unique_ptr<TrafficSource> make_traffic_source (const config& cfg, uint32_t index, const std::vector<uint64_t>& bases = { 0 }) {
+    if (cfg.traffic.source == "trace") {
+        std::string path = cfg.traffic.trace;
+        size_t at = path.find("{master}");
+        if (at != std::string::npos) {
+            path.replace(at, 8, std::to_string(index));
+        }
+        return std::unique_ptr<TrafficSource>(new TraceSource(path));
+    }
+    if (cfg.traffic.source == "random") {
+        return std::unique_ptr<TrafficSource>(new RandomSource(bases, cfg.traffic.seed, Xoshiro256::source_stream(index)));
+    }
+    if (cfg.traffic.source == "pattern") {
+        const traffic_pattern& p = cfg.traffic.patterns.at(std::min<size_t>(index, cfg.traffic.patterns.size() - 1));
+        return std::unique_ptr<TrafficSource>(new PatternSource(p, cfg.traffic.seed, Xoshiro256::source_stream(index)));
+    }
+    throw std::invalid_argument("unknown traffic.source: " + cfg.traffic.source);
+}
+
+#endif
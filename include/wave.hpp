@@ -0,0 +1,224 @@
+#ifndef WAVE_HPP
+#define WAVE_HPP
+
+#include <systemc>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <type_traits>
+#include <algorithm>
+#include <cstdint>
+#include "config.hpp"
+#include "stats.hpp"
+#include "async_writer.hpp"
+
+// Change-driven VCD capture, a replacement for sc_trace when only part of a
+// run matters. Only signals on the channels listed in trace.channels are
+// watched, and only while the capture window is open:
+//   opens   at trace.start_ns, once trace.start_after_transactions bursts
+//           have completed and, if set, a burst slower than
+//           trace.latency_trigger_ns has been seen
+//   closes  trace.duration_ns after opening, or at trace.stop_ns
+// Text is formatted into large chunks and handed to an AsyncWriter, which
+// gzips it on its own thread when trace.file ends in ".gz".
+//
+// Values wider than 64 bits (data beats, strobes) show their low 64 bits.
+// Signals are registered with add() during elaboration. Nothing is built
+// when trace.enable is false, so a disabled trace costs nothing.
+SC_MODULE (WaveTracer) {
+    SC_HAS_PROCESS(WaveTracer);
+    WaveTracer(sc_core::sc_module_name name, const config& cfg)
+        : sc_module(name)
+        , cfg(cfg.trace)
+        , writer(cfg.trace.file, cfg.trace.file.size() > 3 && cfg.trace.file.compare(cfg.trace.file.size() - 3, 3, ".gz") == 0)
+    {
+        buffer.reserve(CHUNK_BYTES + 4096);
+
+        SC_METHOD(sample_process);
+        dont_initialize();
+    }
+
+    ~WaveTracer () {
+        finish();
+    }
+
+    // trigger conditions are evaluated against these masters
+    void watch (const Stats& stats) {
+        watched.push_back(&stats);
+    }
+
+    template <typename T>
+    void add (const std::string& channel, const std::string& name, const sc_core::sc_signal_in_if<T>& signal) {
+        if (std::find(cfg.channels.begin(), cfg.channels.end(), channel) == cfg.channels.end()) {
+            return;
+        }
+        probe p;
+        p.name = name;
+        p.width = std::is_same<T, bool>::value ? 1 : 8 * std::min(sizeof(T), sizeof(uint64_t));
+        p.code = vcd_code(probes.size());
+        p.read = [&signal] { return static_cast<uint64_t>(signal.read()); };
+        probes.push_back(p);
+        sensitive << signal.value_changed_event();
+    }
+
+    // close the capture after sc_start returns
+    void finish () {
+        if (finished) {
+            return;
+        }
+        finished = true;
+        if (state == OPEN) {
+            timestamp();
+        }
+        flush(true);
+        writer.close();
+    }
+
+private:
+    static constexpr size_t CHUNK_BYTES = 1 << 20;
+
+    enum window_state { WAITING, OPEN, CLOSED };
+
+    struct probe {
+        std::string name;
+        uint32_t width;
+        std::string code;
+        std::function<uint64_t()> read;
+        uint64_t last = 0;
+    };
+
+    decltype(config::trace) cfg;
+    AsyncWriter writer;
+    std::vector<probe> probes;
+    std::vector<const Stats*> watched;
+    std::string buffer;
+    window_state state = WAITING;
+    double close_ns = 0;
+    uint64_t last_ps = UINT64_MAX;
+    bool finished = false;
+    sc_core::sc_event never;
+
+    static std::string vcd_code (size_t index) {
+        std::string code;
+        do {
+            code += static_cast<char>('!' + index % 94);
+            index /= 94;
+        } while (index);
+        return code;
+    }
+
+    double now_ns () const {
+        return sc_core::sc_time_stamp().to_seconds() * 1e9;
+    }
+
+    bool triggered () const {
+        uint64_t done = 0;
+        double worst = 0;
+        for (const Stats* s : watched) {
+            done += s->completions();
+            worst = std::max(worst, s->worst_latency());
+        }
+        return done >= cfg.start_after_transactions
+            && (cfg.latency_trigger_ns <= 0 || worst >= cfg.latency_trigger_ns);
+    }
+
+    void sample_process () {
+        double now = now_ns();
+        if (state == CLOSED) {
+            return;
+        }
+        if (state == WAITING) {
+            if (now < cfg.start_ns) {
+                next_trigger(cfg.start_ns - now, sc_core::SC_NS);
+                return;
+            }
+            if (!triggered()) {
+                return;
+            }
+            open(now);
+            return;
+        }
+        if (now >= close_ns) {
+            timestamp();
+            state = CLOSED;
+            flush(true);
+            next_trigger(never);
+            return;
+        }
+
+        bool stamped = false;
+        for (probe& p : probes) {
+            uint64_t value = p.read();
+            if (value != p.last) {
+                if (!stamped) {
+                    timestamp();
+                    stamped = true;
+                }
+                p.last = value;
+                emit(p);
+            }
+        }
+        flush(false);
+    }
+
+    // every probe is registered by now; the header goes out even if the
+    // window never opens, so the file is always a valid VCD
+    void start_of_simulation () override {
+        buffer += "$timescale 1ps $end\n$scope module axi $end\n";
+        for (const probe& p : probes) {
+            buffer += "$var wire " + std::to_string(p.width) + " " + p.code + " " + p.name + " $end\n";
+        }
+        buffer += "$upscope $end\n$enddefinitions $end\n";
+    }
+
+    void open (double now) {
+        state = OPEN;
+        close_ns = cfg.stop_ns > 0 ? cfg.stop_ns : 1e300;
+        if (cfg.duration_ns > 0) {
+            close_ns = std::min(close_ns, now + cfg.duration_ns);
+        }
+
+        timestamp();
+        buffer += "$dumpvars\n";
+        for (probe& p : probes) {
+            p.last = p.read();
+            emit(p);
+        }
+        buffer += "$end\n";
+        flush(false);
+    }
+
+    void timestamp () {
+        uint64_t ps = static_cast<uint64_t>(sc_core::sc_time_stamp().to_seconds() * 1e12 + 0.5);
+        if (ps != last_ps) {
+            buffer += "#" + std::to_string(ps) + "\n";
+            last_ps = ps;
+        }
+    }
+
+    void emit (const probe& p) {
+        if (p.width == 1) {
+            buffer += p.last ? '1' : '0';
+        } else {
+            buffer += 'b';
+            int top = p.last ? 63 - __builtin_clzll(p.last) : 0;
+            for (int bit = top; bit >= 0; bit--) {
+                buffer += (p.last >> bit) & 1 ? '1' : '0';
+            }
+            buffer += ' ';
+        }
+        buffer += p.code;
+        buffer += '\n';
+    }
+
+    void flush (bool force) {
+        if (buffer.size() >= CHUNK_BYTES || (force && !buffer.empty())) {
+            writer.write(std::move(buffer));
+            buffer = std::string();
+            buffer.reserve(CHUNK_BYTES + 4096);
+        }
+    }
+};
+
+#endif
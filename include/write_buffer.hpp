@@ -0,0 +1,251 @@
+#ifndef WRITE_BUFFER_HPP
+#define WRITE_BUFFER_HPP
+
+#include <vector>
+#include <ostream>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+#include "config.hpp"
+#include "dram.hpp"
+#include "channels/AXICommon.hpp"
+#include "channels/AXIBurst.hpp"
+#include "checkpoint.hpp"
+
+// Write-combining buffer in front of a DRAMModel, shared by the slaves. It
+// is a timing model only: the data still goes to SparseMemory at once, so
+// what a read returns does not depend on it.
+//
+// A write burst is committed once its lines (write_buffer.line_bytes each)
+// are buffered; a write to a line already held merges into it instead of
+// taking a second DRAM access. When high_watermark lines are held, the
+// buffer drains down to low_watermark, one DRAM row at a time: first rows
+// that are open in their bank, then in address order, all lines of a row
+// back to back, so the batch pays one activate per row rather than one per
+// write. Only a write that finds the buffer full waits for a drain.
+//
+// A read whose beats are all buffered is served from the buffer after
+// hit_ns; one that overlaps buffered lines only in part drains those lines
+// first and then reads the DRAM, behind them. entries: 0 turns the buffer
+// off and every access goes to the DRAM as it comes.
+class WriteBuffer {
+public:
+    uint64_t writes = 0;
+    uint64_t write_lines = 0;
+    uint64_t merged_lines = 0;  // landed on a line already buffered
+    uint64_t reads = 0;
+    uint64_t read_hits = 0;     // served from the buffer
+    uint64_t read_partial = 0;  // drained the overlapping lines first
+    uint64_t drains = 0;        // watermark batches
+    uint64_t forced_drains = 0; // a write found the buffer full
+    uint64_t drained_lines = 0;
+    uint64_t drained_rows = 0;
+    uint64_t max_lines = 0;
+
+    WriteBuffer (const config& cfg, DRAMModel& dram)
+        : dram(dram)
+        , capacity(cfg.write_buffer.entries)
+        , line_bytes(cfg.write_buffer.line_bytes)
+        , high(cfg.write_buffer.high_watermark)
+        , low(cfg.write_buffer.low_watermark)
+        , hit_ns(cfg.write_buffer.hit_ns)
+    {
+        if (!enabled()) {
+            return;
+        }
+        if (line_bytes < BEAT_BYTES || line_bytes > 64 * BEAT_BYTES || (line_bytes & (line_bytes - 1))) {
+            throw std::invalid_argument("write_buffer.line_bytes must be a power of two from one beat to 64 beats");
+        }
+        if (low >= high || high > capacity) {
+            throw std::invalid_argument("write_buffer needs low_watermark < high_watermark <= entries");
+        }
+        lines.reserve(capacity);
+    }
+
+    bool enabled () const {
+        return capacity > 0;
+    }
+
+    // when the write is committed: buffered, or written when the buffer is off
+    double write (const AXI_REQ& req, double now) {
+        if (!enabled()) {
+            return dram.access(req.addr, now);
+        }
+        writes++;
+        double committed = now;
+        uint64_t lo, hi;
+        burst_span(req, lo, hi);
+        for (uint64_t l = lo / line_bytes; l <= (hi - 1) / line_bytes; l++) {
+            write_lines++;
+            auto it = find(l);
+            if (it != lines.end() && it->line == l) {
+                it->beats |= beat_mask(l, lo, hi);
+                merged_lines++;
+                continue;
+            }
+            if (lines.size() == capacity) {
+                forced_drains++;
+                committed = std::max(committed, drain(now));
+                it = find(l);
+            }
+            lines.insert(it, { l, beat_mask(l, lo, hi) });
+        }
+        max_lines = std::max<uint64_t>(max_lines, lines.size());
+        if (lines.size() >= high) {
+            drains++;
+            drain(now);
+        }
+        return committed;
+    }
+
+    // when the read data is available
+    double read (const AXI_REQ& req, double now) {
+        if (!enabled()) {
+            return dram.access(req.addr, now);
+        }
+        reads++;
+        uint64_t lo, hi;
+        burst_span(req, lo, hi);
+        bool covered = true;
+        bool touched = false;
+        for (uint64_t l = lo / line_bytes; l <= (hi - 1) / line_bytes; l++) {
+            auto it = find(l);
+            uint64_t need = beat_mask(l, lo, hi);
+            bool held = it != lines.end() && it->line == l;
+            covered = covered && held && (it->beats & need) == need;
+            touched = touched || (held && (it->beats & need));
+        }
+        if (covered) {
+            read_hits++;
+            return now + hit_ns;
+        }
+        if (touched) {
+            read_partial++;
+            for (uint64_t l = lo / line_bytes; l <= (hi - 1) / line_bytes; l++) {
+                auto it = find(l);
+                if (it != lines.end() && it->line == l) {
+                    write_back(it->line, now);
+                    lines.erase(it);
+                }
+            }
+        }
+        return dram.access(req.addr, now);
+    }
+
+    // buffered lines and counters; timing parameters come from the config
+    void save (CheckpointWriter& out) const {
+        out.tag("write_buffer");
+        out.put(lines);
+        out.put(writes);
+        out.put(write_lines);
+        out.put(merged_lines);
+        out.put(reads);
+        out.put(read_hits);
+        out.put(read_partial);
+        out.put(drains);
+        out.put(forced_drains);
+        out.put(drained_lines);
+        out.put(drained_rows);
+        out.put(max_lines);
+    }
+
+    void restore (CheckpointReader& in) {
+        in.expect("write_buffer");
+        in.get(lines);
+        if (lines.size() > capacity) {
+            throw std::runtime_error("checkpoint holds more write_buffer lines than write_buffer.entries");
+        }
+        lines.reserve(capacity);
+        in.get(writes);
+        in.get(write_lines);
+        in.get(merged_lines);
+        in.get(reads);
+        in.get(read_hits);
+        in.get(read_partial);
+        in.get(drains);
+        in.get(forced_drains);
+        in.get(drained_lines);
+        in.get(drained_rows);
+        in.get(max_lines);
+    }
+
+    void report (std::ostream& os) const {
+        if (!enabled()) {
+            return;
+        }
+        os << "[WB] writes: " << writes
+           << ", merged_lines: " << merged_lines << "/" << write_lines
+           << ", reads: " << reads
+           << ", read_hits: " << read_hits
+           << ", read_partial: " << read_partial
+           << ", hit_rate: " << (reads ? double(read_hits) / reads : 0)
+           << ", drains: " << drains
+           << ", forced_drains: " << forced_drains
+           << ", drained_lines: " << drained_lines
+           << ", lines_per_row: " << (drained_rows ? double(drained_lines) / drained_rows : 0)
+           << ", max_lines: " << max_lines << std::endl;
+    }
+
+private:
+    struct entry {
+        uint64_t line;  // address / line_bytes
+        uint64_t beats; // beats of the line written, bit per BEAT_BYTES
+    };
+
+    DRAMModel& dram;
+    uint32_t capacity;
+    uint32_t line_bytes;
+    uint32_t high;
+    uint32_t low;
+    double hit_ns;
+    std::vector<entry> lines; // by line, at most capacity
+
+    std::vector<entry>::iterator find (uint64_t line) {
+        return std::lower_bound(lines.begin(), lines.end(), line,
+                                [](const entry& e, uint64_t l) { return e.line < l; });
+    }
+
+    uint64_t row_of (uint64_t line) const {
+        return dram.row_key(line * line_bytes);
+    }
+
+    uint64_t beat_mask (uint64_t line, uint64_t lo, uint64_t hi) const {
+        uint64_t base = line * line_bytes;
+        uint64_t first = (std::max(lo, base) - base) / BEAT_BYTES;
+        uint64_t last = (std::min(hi, base + line_bytes) - base + BEAT_BYTES - 1) / BEAT_BYTES;
+        uint64_t beats = last - first;
+        return (beats >= 64 ? ~uint64_t(0) : (uint64_t(1) << beats) - 1) << first;
+    }
+
+    double write_back (uint64_t line, double now) {
+        drained_lines++;
+        return dram.access(line * line_bytes, now);
+    }
+
+    // rows out until low lines are left; when the last one is written
+    double drain (double now) {
+        double done = now;
+        while (lines.size() > low) {
+            // lines are sorted, so the lines of a row sit together
+            auto first = std::find_if(lines.begin(), lines.end(),
+                                      [this](const entry& e) { return dram.row_hit(e.line * line_bytes); });
+            if (first == lines.end()) {
+                first = lines.begin();
+            }
+            uint64_t row = row_of(first->line);
+            while (first != lines.begin() && row_of((first - 1)->line) == row) {
+                --first;
+            }
+            auto last = first;
+            while (last != lines.end() && row_of(last->line) == row) {
+                done = std::max(done, write_back(last->line, now));
+                ++last;
+            }
+            lines.erase(first, last);
+            drained_rows++;
+        }
+        return done;
+    }
+};
+
+#endif
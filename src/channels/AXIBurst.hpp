@@ -0,0 +1,160 @@
+#pragma once
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+#include <cctype>
+#include "AXICommon.hpp"
+
+// AXI4 burst addressing. A burst is len + 1 beats of up to 1 << size bytes.
+// Each beat drives the byte lanes its address selects on the BEAT_BYTES
+// wide bus, so narrow and unaligned beats leave the other lanes idle.
+//   FIXED  every beat at addr, e.g. a FIFO register; at most 16 beats
+//   INCR   addr, then each following size-aligned address; at most 256
+//          beats, never across a 4KB boundary
+//   WRAP   like INCR, but wraps inside the burst-sized aligned window, so a
+//          cache line fill can start at the critical word; 2, 4, 8 or 16
+//          beats from a size-aligned addr
+
+// "fixed" | "incr" | "wrap", as written in config and traces
+inline uint32_t burst_type (const std::string& name) {
+    std::string lower = name;
+    std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+    if (lower == "fixed") return BURST_FIXED;
+    if (lower == "incr")  return BURST_INCR;
+    if (lower == "wrap")  return BURST_WRAP;
+    throw std::invalid_argument("unknown burst type: " + name);
+}
+
+inline uint32_t burst_beats (const AXI_REQ& req) {
+    return req.len + 1;
+}
+
+// address of beat n
+inline uint64_t beat_address (const AXI_REQ& req, uint32_t n) {
+    if (n == 0 || req.burst == BURST_FIXED) {
+        return req.addr;
+    }
+    uint64_t bytes = uint64_t(1) << req.size;
+    uint64_t aligned = req.addr & ~(bytes - 1);
+    if (req.burst == BURST_WRAP) {
+        uint64_t window = bytes * burst_beats(req);
+        uint64_t lower = req.addr & ~(window - 1);
+        return lower + ((aligned - lower + n * bytes) & (window - 1));
+    }
+    return aligned + n * bytes;
+}
+
+// byte lanes [lo, hi) that beat n drives
+inline void beat_lanes (const AXI_REQ& req, uint32_t n, uint32_t& lo, uint32_t& hi) {
+    uint64_t addr = beat_address(req, n);
+    uint64_t bytes = uint64_t(1) << req.size;
+    lo = addr & (BEAT_BYTES - 1);
+    hi = ((addr & ~(bytes - 1)) & (BEAT_BYTES - 1)) + bytes;
+}
+
+inline AXIStrobe beat_strobe (const AXI_REQ& req, uint32_t n) {
+    uint32_t lo, hi;
+    beat_lanes(req, n, lo, hi);
+    AXIStrobe strb;
+    if (hi - lo < BEAT_BYTES) {
+        strb.clear_all();
+        for (uint32_t lane = lo; lane < hi; lane++) {
+            strb.set(lane);
+        }
+    }
+    return strb;
+}
+
+// bytes the burst actually moves; an unaligned start drops the lanes below
+// addr, on the first beat or, for FIXED, on every beat
+inline uint64_t burst_bytes (const AXI_REQ& req) {
+    uint64_t bytes = uint64_t(1) << req.size;
+    uint64_t skipped = req.addr & (bytes - 1);
+    if (req.burst == BURST_FIXED) {
+        return burst_beats(req) * (bytes - skipped);
+    }
+    return burst_beats(req) * bytes - skipped;
+}
+
+// bytes [lo, hi) the burst can touch, whole size-aligned transfers
+inline void burst_span (const AXI_REQ& req, uint64_t& lo, uint64_t& hi) {
+    uint64_t bytes = uint64_t(1) << req.size;
+    if (req.burst == BURST_WRAP) {
+        uint64_t window = bytes * burst_beats(req);
+        lo = req.addr & ~(window - 1);
+        hi = lo + window;
+        return;
+    }
+    lo = req.addr & ~(bytes - 1);
+    hi = lo + (req.burst == BURST_FIXED ? bytes : burst_beats(req) * bytes);
+}
+
+inline bool bursts_overlap (const AXI_REQ& a, const AXI_REQ& b) {
+    uint64_t a_lo, a_hi, b_lo, b_hi;
+    burst_span(a, a_lo, a_hi);
+    burst_span(b, b_lo, b_hi);
+    return a_lo < b_hi && b_lo < a_hi;
+}
+
+// why req is not a legal AXI4 burst on this bus, or nullptr
+inline const char* burst_error (const AXI_REQ& req) {
+    if (req.size > BUS_WIDTH) {
+        return "AxSIZE is wider than the data bus";
+    }
+    uint64_t bytes = uint64_t(1) << req.size;
+    switch (req.burst) {
+    case BURST_FIXED:
+        if (req.len > 15) {
+            return "FIXED burst longer than 16 beats";
+        }
+        return nullptr;
+    case BURST_INCR: {
+        if (req.len > 255) {
+            return "INCR burst longer than 256 beats";
+        }
+        uint64_t last = (req.addr & ~(bytes - 1)) + burst_beats(req) * bytes - 1;
+        if ((req.addr >> 12) != (last >> 12)) {
+            return "INCR burst crosses a 4KB boundary";
+        }
+        return nullptr;
+    }
+    case BURST_WRAP:
+        if (req.len != 1 && req.len != 3 && req.len != 7 && req.len != 15) {
+            return "WRAP burst must be 2, 4, 8 or 16 beats";
+        }
+        if (req.addr & (bytes - 1)) {
+            return "WRAP burst address is not aligned to AxSIZE";
+        }
+        return nullptr;
+    default:
+        return "unknown AxBURST";
+    }
+}
+
+// Hands emit() the legal bursts for req: an INCR burst is cut at every 4KB
+// boundary and every 256 beats, anything else is passed through as is.
+// Throws std::invalid_argument for a burst that no split can make legal.
+template <typename Emit>
+inline void split_burst (const AXI_REQ& req, Emit emit) {
+    if (req.burst == BURST_INCR && req.size <= BUS_WIDTH) {
+        uint64_t bytes = uint64_t(1) << req.size;
+        uint64_t addr = req.addr;
+        uint64_t remaining = burst_beats(req);
+        while (remaining > 0) {
+            uint64_t aligned = addr & ~(bytes - 1);
+            uint64_t to_boundary = (((aligned >> 12) + 1) << 12) - aligned;
+            uint64_t beats = std::min<uint64_t>({ remaining, 256, to_boundary / bytes });
+            AXI_REQ part = req;
+            part.addr = static_cast<uint32_t>(addr);
+            part.len = static_cast<uint32_t>(beats - 1);
+            emit(part);
+            remaining -= beats;
+            addr = aligned + beats * bytes;
+        }
+        return;
+    }
+    if (const char* error = burst_error(req)) {
+        throw std::invalid_argument(std::string("illegal AXI burst: ") + error);
+    }
+    emit(req);
+}
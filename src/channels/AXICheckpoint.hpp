@@ -0,0 +1,115 @@
+#pragma once
+#include <systemc>
+#include <string>
+#include <iostream>
+#include "AXIHandshake.hpp"
+#include "AXIMaster.hpp"
+#include "AXISlave.hpp"
+#include "checkpoint.hpp"
+#include "config.hpp"
+
+using namespace sc_core;
+
+// Checkpoints of the pin model: writes checkpoint.save once the trigger is
+// reached and starts the model from checkpoint.restore.
+//
+// A thread cannot be saved halfway through its loop, so a checkpoint is
+// taken where no burst is in flight: at the trigger the master parks its
+// generator between two requests and then stops issuing, and the state is
+// written on the first edge at which the master and slave have drained.
+// Bursts still queued in the master are saved with the generator and PRNG
+// state, the DRAM banks, the write buffer, the prefetcher, the memory
+// contents and the statistics.
+//
+// A restored run starts its clock on the checkpoint's edge with the master
+// held, and releases it on that edge, as the saving run does when it goes
+// on (checkpoint.stop: false); from there both runs are the same. The
+// trigger and the drain test sample the master and slave on the edge, see
+// AXIHandshake.hpp. Timing parameters come from the restoring config and
+// may differ from the saving one; structure (banks, page size, queue and
+// outstanding depths) may not.
+SC_MODULE (AXICheckpoint) {
+    sc_in<bool> clk;
+
+    SC_HAS_PROCESS(AXICheckpoint);
+    AXICheckpoint(sc_module_name name, const config& cfg, AXIMaster& master, AXISlave& slave)
+        : sc_module(name)
+        , master(master)
+        , slave(slave)
+        , save_path(cfg.checkpoint.save)
+        , at_ns(cfg.checkpoint.at_ns)
+        , at_transactions(cfg.checkpoint.at_transactions)
+        , stop(cfg.checkpoint.stop)
+        , restored(!cfg.checkpoint.restore.empty())
+    {
+        if (restored) {
+            CheckpointReader in(cfg.checkpoint.restore);
+            in.expect("checkpoint");
+            in.get(resume_ns);
+            master.restore(in);
+            slave.restore(in);
+            std::cout << "[Checkpoint] restored " << cfg.checkpoint.restore << " at " << resume_ns << " ns" << std::endl;
+        }
+
+        SC_THREAD(checkpoint_process);
+        sensitive << clk.pos();
+    }
+
+    // first clock edge of the run, ns; 0 unless restored
+    double resume_time () const {
+        return resume_ns;
+    }
+
+private:
+    AXIMaster& master;
+    AXISlave& slave;
+    std::string save_path;
+    double at_ns;
+    uint64_t at_transactions;
+    bool stop;
+    bool restored;
+    double resume_ns = 0;
+
+    double now_ns () const {
+        return sc_time_stamp().to_seconds() * 1e9;
+    }
+
+    void checkpoint_process () {
+        if (restored) {
+            wait();
+            master.release();
+        }
+        if (save_path.empty()) {
+            return;
+        }
+
+        if (at_transactions > 0) {
+            wait_until(clk, master.done_event, [this] { return master.completed() >= at_transactions; });
+        } else {
+            if (at_ns > now_ns()) {
+                wait(at_ns - now_ns(), SC_NS);
+            }
+            wait();
+        }
+
+        master.hold();
+        // polled: the drain lasts as long as the bursts in flight
+        while (!master.drained() || !slave.drained()) {
+            wait();
+        }
+
+        CheckpointWriter out(save_path);
+        out.tag("checkpoint");
+        out.put(now_ns());
+        master.save(out);
+        slave.save(out);
+        out.finish();
+        std::cout << "[Checkpoint] saved " << save_path << " at " << now_ns() << " ns" << std::endl;
+
+        if (stop) {
+            sc_stop();
+        } else {
+            master.release();
+        }
+    }
+};
@@ -2,28 +2,93 @@
 #define AXICOMMON_HPP
 
 #include <stdint.h>
-
-#define COL_INDEX(x)    (x & 0xFFF)
-#define ROW_INDEX(x)    (x >> 12)
-#define ADDRESS(r, c)   ((r << 12) | (c & 0xFFF))
+#include <string.h>
+#include <ostream>
 
 #define BUS_WIDTH       (7) // 128B
+#define BEAT_BYTES      (1u << BUS_WIDTH)
 #define READ            (0)
 #define WRITE           (1)
 
+// AxBURST
+#define BURST_FIXED     (0)
+#define BURST_INCR      (1)
+#define BURST_WRAP      (2)
+
+// BRESP / RRESP
+#define RESP_OKAY       (0)
+#define RESP_EXOKAY     (1)
+#define RESP_SLVERR     (2)
+#define RESP_DECERR     (3)
+
 struct AXI_REQ {
     uint32_t type;
     uint32_t id;
     uint32_t addr;
-    uint32_t size;
-    uint32_t len;
+    uint32_t size;  // AxSIZE, bytes per beat = 1 << size
+    uint32_t len;   // AxLEN, beats = len + 1
+    uint32_t burst = BURST_INCR;
+    double issue_time; // ns, AR/AW issue
 };
 
-struct AR_REQ {
-    uint32_t arid;
-    uint32_t araddr;
-    uint32_t arsize;
-    uint32_t arlen; 
+// One data beat on R or W. The sender owns the BEAT_BYTES behind data and
+// keeps them unchanged until the receiver has sampled the beat, so a beat
+// costs one pointer on the signal rather than a 128B copy.
+struct AXIBeat {
+    const uint8_t* data = nullptr;
+
+    bool operator== (const AXIBeat& other) const { return data == other.data; }
+
+    // first 8 bytes, for waveforms
+    explicit operator uint64_t () const {
+        uint64_t word = 0;
+        if (data) {
+            memcpy(&word, data, sizeof(word));
+        }
+        return word;
+    }
 };
 
+inline std::ostream& operator<< (std::ostream& os, const AXIBeat& beat) {
+    return os << static_cast<uint64_t>(beat);
+}
+
+// WSTRB: one enable bit per byte lane of a beat
+struct AXIStrobe {
+    uint64_t bits[BEAT_BYTES / 64];
+
+    AXIStrobe () { set_all(); }
+
+    void set_all () { memset(bits, 0xFF, sizeof(bits)); }
+    void clear_all () { memset(bits, 0, sizeof(bits)); }
+    void set (uint32_t lane) { bits[lane / 64] |= 1ull << (lane % 64); }
+    void clear (uint32_t lane) { bits[lane / 64] &= ~(1ull << (lane % 64)); }
+    bool test (uint32_t lane) const { return (bits[lane / 64] >> (lane % 64)) & 1; }
+
+    uint32_t count () const {
+        uint32_t n = 0;
+        for (uint64_t word : bits) {
+            n += __builtin_popcountll(word);
+        }
+        return n;
+    }
+
+    bool full () const {
+        for (uint64_t word : bits) {
+            if (word != ~0ull) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool operator== (const AXIStrobe& other) const { return memcmp(bits, other.bits, sizeof(bits)) == 0; }
+
+    explicit operator uint64_t () const { return bits[0]; }
+};
+
+inline std::ostream& operator<< (std::ostream& os, const AXIStrobe& strb) {
+    return os << std::hex << strb.bits[0] << std::dec;
+}
+
 #endif // AXICOMMON_HPP
\ No newline at end of file
@@ -0,0 +1,120 @@
+#pragma once
+#include <systemc>
+#include <cstdint>
+
+// The threads of the pin-level master and slave share queues and tables
+// besides their pins. SystemC does not say in which order it runs the
+// threads woken by the same edge, so what one of them reads of another's
+// state must not depend on whether that other thread already ran:
+//
+// - Such state is sampled on the edge, like a signal: a change made on a
+//   rising edge is seen from the next one, a change made between edges (a
+//   timed wait ending) from the first edge after it. The thread making it
+//   stamps it with edge_stamp(), readers ask seen().
+// - A thread that samples on one edge and acts on the next (takes the
+//   queue head it saw, say) has announced what it does on that next edge,
+//   so the others may count on it there whether it ran yet or not.
+// - Every event a thread sleeps on is delta-notified, like a signal's
+//   value_changed_event, so the sleeper wakes in the delta after the
+//   change.
+//
+// wait_until then blocks a clocked thread until the first rising edge of
+// clk at which cond() holds, i.e. what
+//     while (!cond()) wait();   // sensitive << clk.pos()
+// does, without waking on every idle edge. The thread sleeps on `change`,
+// the event that can make cond() true; woken in the delta of a rising
+// edge, the change came before that edge and it checks right away,
+// otherwise it checks on the next edge. A thread that comes in between
+// edges (after a timed wait) checks on the next edge before it sleeps:
+// the change it would wait for may have been announced while it was away.
+//
+// Build with -DAXI_POLLING_HANDSHAKE to get the polling loop back;
+// make handshake-check compares both builds burst by burst.
+template <typename Cond>
+inline void wait_until (const sc_core::sc_in<bool>& clk, const sc_core::sc_event& change, Cond cond) {
+#ifdef AXI_POLLING_HANDSHAKE
+    (void)clk;
+    (void)change;
+    while (!cond()) {
+        sc_core::wait();
+    }
+#else
+    if (!cond() && !clk.posedge()) {
+        sc_core::wait(clk.posedge_event());
+    }
+    while (!cond()) {
+        sc_core::wait(change);
+        if (!clk.posedge()) {
+            sc_core::wait(clk.posedge_event());
+        }
+    }
+#endif
+}
+
+// when a thread changed shared state: the time, and whether the clock had
+// already risen then, i.e. a thread of that edge made the change rather
+// than a timed wait ending just before it
+struct EdgeStamp {
+    sc_core::sc_time at;
+    bool after_edge = false;
+
+    bool operator== (const EdgeStamp& o) const {
+        return at == o.at && after_edge == o.after_edge;
+    }
+};
+
+inline EdgeStamp edge_stamp (const sc_core::sc_in<bool>& clk) {
+    return { sc_core::sc_time_stamp(), clk.read() };
+}
+
+// whether a thread running now sees a change stamped s
+inline bool seen (const sc_core::sc_in<bool>& clk, const EdgeStamp& s) {
+    sc_core::sc_time now = sc_core::sc_time_stamp();
+    return s.at < now || (s.at == now && !s.after_edge && clk.read());
+}
+
+// Entries appended to a queue (or slots returned to a table) that other
+// threads must not see yet: those added since the last edge the readers
+// run on, which share one stamp.
+class EdgeTail {
+public:
+    void pushed (const sc_core::sc_in<bool>& clk) {
+        EdgeStamp s = edge_stamp(clk);
+        count = s == last ? count + 1 : 1;
+        last = s;
+    }
+
+    uint32_t unseen (const sc_core::sc_in<bool>& clk) const {
+        return seen(clk, last) ? 0 : count;
+    }
+
+private:
+    EdgeStamp last;
+    uint32_t count = 0;
+};
+
+// A flag or count that readers see as it stood before the current edge:
+// a change made on an edge shows from the next one, as with a signal.
+template <typename T>
+class EdgeSampled {
+public:
+    explicit EdgeSampled (T v = T()) : value(v), before(v) {}
+
+    void set (const sc_core::sc_in<bool>& clk, T v) {
+        EdgeStamp s = edge_stamp(clk);
+        if (!(s == stamp)) {
+            before = value;
+            stamp = s;
+        }
+        value = v;
+    }
+
+    T get (const sc_core::sc_in<bool>& clk) const {
+        return seen(clk, stamp) ? value : before;
+    }
+
+private:
+    T value;
+    T before;
+    EdgeStamp stamp;
+};
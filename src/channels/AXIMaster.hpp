@@ -1,17 +1,27 @@
 #pragma once
 #include <systemc>
-#include <deque>
-#include <unordered_map>
-#include <cstdlib>
-#include <ctime>
+#include <memory>
+#include <vector>
+#include <functional>
 #include "AXICommon.hpp"
+#include "AXIHandshake.hpp"
+#include "AXIBurst.hpp"
+#include "AXITable.hpp"
+#include "config.hpp"
+#include "traffic.hpp"
+#include "stats.hpp"
+#include "issue.hpp"
+#include "checkpoint.hpp"
 
 using namespace sc_core;
 
 SC_MODULE (AXIMaster) {
     double total_data_received = 0;
-    uint32_t m_arid = 0x00;
-    uint32_t m_awid = 0x00;
+    double total_read_latency = 0;  // ns, AR issue -> RLAST
+    double total_write_latency = 0; // ns, AW issue -> B
+    uint64_t read_count = 0;
+    uint64_t write_count = 0;
+    Stats stats;
 
     sc_in<bool>      clk;
         
@@ -22,12 +32,13 @@ SC_MODULE (AXIMaster) {
     sc_out<uint32_t>  araddr;    // master -> slave
     sc_out<uint32_t>  arsize;    // master -> slave
     sc_out<uint32_t>  arlen;     // master -> slave
+    sc_out<uint32_t>  arburst;   // master -> slave
 
     // R channel
     sc_in<bool>       rvalid;
     sc_out<bool>      rready;
     sc_in<uint32_t>   rid;
-    sc_in<uint32_t>   rdata;
+    sc_in<AXIBeat>    rdata;
     sc_in<bool>       rlast;
 
     // AW channel
@@ -37,25 +48,54 @@ SC_MODULE (AXIMaster) {
     sc_out<uint32_t>  awaddr;    // master -> slave
     sc_out<uint32_t>  awsize;    // master -> slave
     sc_out<uint32_t>  awlen;     // master -> slave
+    sc_out<uint32_t>  awburst;   // master -> slave
 
     // W channel
     sc_in<bool>       wvalid;
     sc_out<bool>      wready;
     sc_in<uint32_t>   wid;
-    sc_out<uint32_t>  wdata;
+    sc_out<AXIBeat>   wdata;
+    sc_out<AXIStrobe> wstrb;
     sc_out<bool>      wlast;
 
-    // // B channel
-    // sc_out<bool>     bvalid_m;
-    // sc_in<bool>      bready_m;
-    // sc_in<uint32_t>  bresp_m;
-
-    sc_mutex fifo_mutex;
-    std::deque<AXI_REQ> req_fifo;
-
-    SC_CTOR(AXIMaster) {
-        srand(time(0));
+    // B channel
+    sc_in<bool>       bvalid;    // slave  -> master
+    sc_out<bool>      bready;    // master -> slave
+    sc_in<uint32_t>   bid;       // slave  -> master
+    sc_in<uint32_t>   bresp;     // slave  -> master
 
+    // a generated burst and its place in program order, which the hazard
+    // checks compare across the two queues
+    struct queued_req {
+        AXI_REQ req;
+        uint64_t seq;
+    };
+    RingQueue<queued_req> rd_fifo;
+    RingQueue<queued_req> wr_fifo;
+
+    // called for every R beat with the burst, the beat index and the
+    // BEAT_BYTES of the bus (beat_lanes() tells which are valid), e.g. to
+    // check what a DMA engine reads back
+    std::function<void(const AXI_REQ&, uint32_t, const uint8_t*)> on_read_beat;
+
+    sc_event done_event; // a burst finished
+
+    SC_HAS_PROCESS(AXIMaster);
+    AXIMaster(sc_module_name name, const config& cfg)
+        : sc_module(name)
+        , stats(cfg.stats.window_ns, cfg.stats.window_slots, cfg.master.max_outstanding_reads, cfg.master.max_outstanding_writes)
+        , rd_fifo(cfg.traffic.queue_depth + 1)
+        , wr_fifo(cfg.traffic.queue_depth + 1)
+        , source(make_traffic_source(cfg, 0))
+        , backpressure(cfg.traffic.mode == "backpressure")
+        , queue_depth(cfg.traffic.queue_depth)
+        , ar_table(cfg.master.max_outstanding_reads)
+        , aw_table(cfg.master.max_outstanding_writes)
+        , r_beats(ar_table.capacity())
+        , scheduler(cfg.master.issue_policy, cfg.master.write_high_watermark, cfg.master.write_low_watermark)
+        , data_rng(cfg.traffic.seed, Xoshiro256::data_stream(0))
+        , clk_period_ns(cfg.clock.period_ns)
+    {
         SC_THREAD(gen_cmd_process);
         sensitive << clk.pos();
 
@@ -71,175 +111,405 @@ SC_MODULE (AXIMaster) {
         SC_THREAD(w_process);
         sensitive << clk.pos();
 
+        SC_THREAD(b_process);
+        sensitive << clk.pos();
+
         arvalid.initialize(false);
+        bready.initialize(false);
         araddr.initialize(0);
+        wdata.initialize(AXIBeat());
     }
 
-    void read (uint32_t addr) {
-        AXI_REQ req;
-        req.type = READ;
-        req.addr = addr;
-        fifo_mutex.lock();
-        req_fifo.push_back(req);
-        fifo_mutex.unlock();
+    // queues req behind the older bursts of its direction, stalling the
+    // calling thread while that queue holds queue_depth requests; a head
+    // ar_process or aw_process takes on this edge is gone already
+    void push (const AXI_REQ& req) {
+        bool read = req.type == READ;
+        RingQueue<queued_req>& fifo = read ? rd_fifo : wr_fifo;
+        const claim& c = read ? ar_claim : aw_claim;
+        wait_until(clk, req_event, [this, &fifo, &c] {
+            return fifo.size() - leaving(c) < queue_depth;
+        });
+        fifo.push_back({ req, next_seq++ });
+        (read ? rd_tail : wr_tail).pushed(clk);
+        req_event.notify(SC_ZERO_TIME);
     }
 
-    void write (uint32_t addr) {
-        AXI_REQ req;
-        req.type = WRITE;
-        req.addr = addr;
-        fifo_mutex.lock();
-        req_fifo.push_back(req);
-        fifo_mutex.unlock();
+    // For checkpoints: hold() parks the generator between two requests and
+    // from then on issues nothing, so whatever is outstanding drains;
+    // release() resumes both. A restored master starts out held. Both take
+    // effect from the next edge.
+    void hold () {
+        holding.set(clk, true);
+    }
+
+    void release () {
+        holding.set(clk, false);
+        req_event.notify(SC_ZERO_TIME);
+    }
+
+    // nothing in flight as of this edge
+    bool drained () const {
+        return gen_parked.get(clk) && !ar_busy.get(clk) && !aw_busy.get(clk)
+            && ar_table.empty() && ar_released.unseen(clk) == 0
+            && aw_table.empty() && aw_released.unseen(clk) == 0;
+    }
+
+    // bursts finished before this edge
+    uint64_t completed () const {
+        return stats.completions() - done_tail.unseen(clk);
+    }
+
+    // generator position, queued bursts, free IDs and counters; only taken drained
+    void save (CheckpointWriter& out) const {
+        out.tag("master");
+        source->save(out);
+        out.put(data_rng);
+        out.put(next_seq);
+        scheduler.save(out);
+        ar_table.save(out);
+        aw_table.save(out);
+        for (const RingQueue<queued_req>* fifo : { &rd_fifo, &wr_fifo }) {
+            std::vector<queued_req> queued;
+            for (size_t i = 0; i < fifo->size(); i++) {
+                queued.push_back((*fifo)[i]);
+            }
+            out.put(queued);
+        }
+        out.put(total_data_received);
+        out.put(total_read_latency);
+        out.put(total_write_latency);
+        out.put(read_count);
+        out.put(write_count);
+        stats.save(out);
+    }
+
+    void restore (CheckpointReader& in) {
+        in.expect("master");
+        source->restore(in);
+        in.get(data_rng);
+        in.get(next_seq);
+        scheduler.restore(in);
+        ar_table.restore(in);
+        aw_table.restore(in);
+        for (RingQueue<queued_req>* fifo : { &rd_fifo, &wr_fifo }) {
+            std::vector<queued_req> queued;
+            in.get(queued);
+            if (queued.size() > queue_depth) {
+                throw std::runtime_error("checkpoint has more queued bursts than traffic.queue_depth");
+            }
+            while (!fifo->empty()) {
+                fifo->pop_front();
+            }
+            for (const queued_req& q : queued) {
+                fifo->push_back(q);
+            }
+        }
+        in.get(total_data_received);
+        in.get(total_read_latency);
+        in.get(total_write_latency);
+        in.get(read_count);
+        in.get(write_count);
+        stats.restore(in);
+        holding = EdgeSampled<bool>(true);
+        gen_parked = EdgeSampled<bool>(true);
     }
 
 private:
-    std::deque<uint32_t> aw_fifo;
-    std::unordered_map<uint32_t, AXI_REQ> ar_requests;
-    std::unordered_map<uint32_t, AXI_REQ> aw_requests;
+    std::unique_ptr<TrafficSource> source;
+    bool backpressure;    // inject whenever the queue has room instead of at source times
+    uint32_t queue_depth; // each queue keeps one more entry for the head leaving on an edge
+    // outstanding bursts; the slot number is the AXI ID on the bus
+    SlotTable<AXI_REQ> ar_table; // AR issued, RLAST not yet received
+    SlotTable<AXI_REQ> aw_table; // AW issued, B not yet received
+    std::vector<uint32_t> r_beats; // per ARID: R beats of its burst taken so far
+    EdgeTail ar_released;        // ar_table slots freed on this edge
+    EdgeTail aw_released;        // aw_table slots freed on this edge
+    IssueScheduler scheduler;
+    uint64_t next_seq = 0;
+    EdgeTail rd_tail; // pushed to rd_fifo on this edge
+    EdgeTail wr_tail; // pushed to wr_fifo on this edge
+    EdgeSampled<bool> ar_busy; // AR granted, handshake not done
+    EdgeSampled<bool> aw_busy;
+    double decided_ns = -1; // edge of the last scheduler decision
+    bool grant_rd = false;
+    bool grant_wr = false;
+    EdgeSampled<bool> holding;    // checkpoint drain, see hold()
+    EdgeSampled<bool> gen_parked; // generator held, or out of requests
+    EdgeTail done_tail;           // bursts finished on this edge
+    Xoshiro256 data_rng; // write data
+    std::vector<uint8_t> w_buffer; // current W burst, beats point into it
+    double clk_period_ns;
+    sc_event req_event; // a queue pushed or popped, a table slot freed or an AR/AW granted or done
+    sc_event ar_event;  // ar_table gained an entry
+
+    // ar_process and aw_process see their queue head granted on one edge
+    // and take it off on the next, see AXIHandshake.hpp
+    struct claim {
+        sc_time due; // edge it leaves its queue on
+        bool open = false;
+    };
+    claim ar_claim;
+    claim aw_claim;
+
+    double now_ns () const {
+        return sc_time_stamp().to_seconds() * 1e9;
+    }
+
+    // rising edges between `since` (itself an edge) and now
+    uint64_t cycles_since (double since) const {
+        return static_cast<uint64_t>((now_ns() - since) / clk_period_ns + 0.5);
+    }
+
+    // on an edge that sees VALID: a stall cycle unless READY was already up
+    void stall_unless (Stats::channel ch, const sc_out<bool>& ready) {
+        if (!ready.read()) {
+            stats.stall(ch);
+        }
+    }
+
+    claim claim_head () const {
+        return { sc_time_stamp() + sc_time(clk_period_ns, SC_NS), true };
+    }
+
+    // the claimed head leaves its queue on this edge and has not yet
+    bool leaving (const claim& c) const {
+        return c.open && sc_time_stamp() == c.due && clk.read();
+    }
+
+    // a table slot was free before this edge
+    bool slot_free (const SlotTable<AXI_REQ>& table, const EdgeTail& released) const {
+        return table.capacity() - table.size() > released.unseen(clk);
+    }
+
+    // an AR issued on an earlier edge is outstanding
+    bool reads_outstanding () {
+        for (uint32_t id = 0; id < ar_table.capacity(); id++) {
+            if (ar_table.contains(id) && ar_table[id].issue_time < now_ns()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // req overlaps a burst outstanding before this edge, counting those
+    // whose slot was freed on it
+    bool overlaps_outstanding (const AXI_REQ& req, SlotTable<AXI_REQ>& table, const EdgeTail& released) {
+        for (uint32_t s = 0; s < table.capacity(); s++) {
+            if (table.contains(s) && bursts_overlap(req, table[s])) {
+                return true;
+            }
+        }
+        for (uint32_t i = 0; i < released.unseen(clk); i++) {
+            if (bursts_overlap(req, table[table.released(i)])) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Same-address ordering across the two queues. A read waits for older
+    // overlapping writes until their B, a write for older overlapping reads
+    // until their RLAST; queues are in seq order, and whatever is already
+    // outstanding is older than the head of the other queue.
+    bool read_blocked (const queued_req& q) {
+        for (size_t i = 0; i < wr_fifo.size() && wr_fifo[i].seq < q.seq; i++) {
+            if (bursts_overlap(q.req, wr_fifo[i].req)) {
+                return true;
+            }
+        }
+        return overlaps_outstanding(q.req, aw_table, aw_released);
+    }
+
+    bool write_blocked (const queued_req& q) {
+        for (size_t i = 0; i < rd_fifo.size() && rd_fifo[i].seq < q.seq; i++) {
+            if (bursts_overlap(q.req, rd_fifo[i].req)) {
+                return true;
+            }
+        }
+        return overlaps_outstanding(q.req, ar_table, ar_released);
+    }
 
-    int randn(int min, int max) {
-        int random_number = rand() % (max - min + 1) + min;
-        return random_number;
+    // Whether a head could issue, from the queues, tables and busy flags as
+    // they stood before this edge. A head taken on this edge was granted on
+    // the last one, so its direction is still busy.
+    bool can_issue (uint32_t type) {
+        if (holding.get(clk) && gen_parked.get(clk)) {
+            return false;
+        }
+        if (type == READ) {
+            return !ar_busy.get(clk) && rd_fifo.size() > rd_tail.unseen(clk)
+                && slot_free(ar_table, ar_released) && !read_blocked(rd_fifo.front());
+        }
+        return !aw_busy.get(clk) && wr_fifo.size() > wr_tail.unseen(clk)
+            && slot_free(aw_table, aw_released) && !write_blocked(wr_fifo.front());
     }
 
-    bool req_queue_empty () {
-        fifo_mutex.lock();
-        bool is_empty = req_fifo.empty();
-        fifo_mutex.unlock();
-        return is_empty;
+    // The scheduler decides once per edge, when ar_process or aw_process
+    // first asks, so both act on the same decision; it only looks at what
+    // was sampled on the edge, so which of them asks first does not matter.
+    bool granted (uint32_t type) {
+        if (decided_ns != now_ns()) {
+            decided_ns = now_ns();
+            uint32_t writes_queued = wr_fifo.size() - wr_tail.unseen(clk);
+            scheduler.decide(can_issue(READ), can_issue(WRITE), writes_queued, grant_rd, grant_wr);
+        }
+        return type == READ ? grant_rd : grant_wr;
     }
 
     void gen_cmd_process() {
-        uint32_t type;
-        uint32_t row;
-        uint32_t col;
-        uint32_t addr;
-        
+        AXI_REQ req;
+        double time_ns;
+
         while (true) {
-            type = randn(READ, WRITE);
-            // type = randn(READ, READ);
-            row  = randn(0, 0);
-            col  = randn(0, 0);
-            addr = ADDRESS(row, col);
-
-            if (type == READ) {
-                read(addr);
-            } else {
-                write(addr);
+            if (holding.get(clk)) {
+                gen_parked.set(clk, true);
+                wait_until(clk, req_event, [this] { return !holding.get(clk); });
+                gen_parked.set(clk, false);
             }
-
-            wait(2.5, sc_core::SC_NS);
+            if (!source->next(req, time_ns)) {
+                break;
+            }
+            if (!backpressure) {
+                double now = sc_time_stamp().to_seconds() * 1e9;
+                if (time_ns > now) {
+                    wait(time_ns - now, sc_core::SC_NS);
+                }
+            }
+            split_burst(req, [this](const AXI_REQ& part) {
+                push(part);
+            });
         }
+        gen_parked.set(clk, true);
     }
 
     void ar_process () {
         while (true) {
-            while (req_queue_empty() || req_fifo.front().type != READ) {
-                wait();
-            }
+            wait_until(clk, req_event, [this] { return granted(READ); });
+            ar_busy.set(clk, true);
+            ar_claim = claim_head();
+            req_event.notify(SC_ZERO_TIME);
 
             wait();
-            AXI_REQ ar_req = req_fifo.front();
-            req_fifo.pop_front();
+            AXI_REQ ar_req = rd_fifo.front().req;
+            rd_fifo.pop_front();
+            ar_claim.open = false;
+            req_event.notify(SC_ZERO_TIME);
     
             {
-                // for AR_REQ and insert ar_requests
-                ar_req.id = m_arid++;
-                ar_req.size = BUS_WIDTH + randn(0, 3); // 128B, 256B, 512B, 1024B 
-                ar_req.len = randn(0, 31); // BL2
-                ar_requests.insert({ar_req.id, ar_req});
-                // std::cout << "[Master][AR] send ar_req { arid: " << ar_req.arid << ", araddr: " << ar_req.araddr << " [r:" << ROW_INDEX(ar_req.araddr) << ",c:" << COL_INDEX(ar_req.araddr) << "] , arsize: " << ar_req.arsize << ", arlen: " << ar_req.arlen << "}" << std::endl;
-
+                // take an ARID slot for the burst
+                ar_req.id = ar_table.alloc(ar_released.unseen(clk));
+                ar_req.issue_time = sc_time_stamp().to_seconds() * 1e9;
+                ar_table[ar_req.id] = ar_req;
+                ar_event.notify(SC_ZERO_TIME);
                 // send ar_request
                 arid.write(ar_req.id);  
                 araddr.write(ar_req.addr);
                 arsize.write(ar_req.size);
                 arlen.write(ar_req.len); 
+                arburst.write(ar_req.burst);
                 arvalid.write(true);
+                stats.issue(READ, ar_req.id, ar_req.issue_time, burst_bytes(ar_req), ar_req.addr);
                 wait();
             }
 
-            while (arready.read() == false) {
-                wait();
-            }
+            double valid_at = now_ns();
+            wait_until(clk, arready.value_changed_event(), [this] { return arready.read(); });
+            stats.stall(Stats::AR, cycles_since(valid_at));
 
+            stats.accept(READ, ar_req.id, sc_time_stamp().to_seconds() * 1e9);
             arvalid.write(false);
+            ar_busy.set(clk, false);
+            req_event.notify(SC_ZERO_TIME);
         }
     }
 
     void r_process () {
         while (true) {
-            while (ar_requests.empty()) {
-                wait();
-            }
-
-            {
-                // listen to rvalid, wait for rdata
-                while (rvalid.read() == false) {
-                    wait();
-                }
-                uint32_t id = rid.read();
+            wait_until(clk, ar_event, [this] { return reads_outstanding(); });
 
-                rready.write(true);
-                wait();
+            // RREADY stays up while any read is outstanding, so a burst
+            // following RLAST is taken without a gap
+            rready.write(true);
+            wait();
 
-                if (ar_requests.find(id) != ar_requests.end()) {
-                    AXI_REQ r_req = ar_requests[id];
-                    uint32_t read_data;
-                    while (true) {
-                        if (rvalid.read() == true) {
-                            read_data = rdata.read();
-                            total_data_received += (1 << BUS_WIDTH);
-                            if (rlast.read() == true) {
-                                rready.write(false);
-                                break;
-                            }
+            // each beat goes to the burst its rid names, so beats of bursts
+            // with different IDs may arrive interleaved (see
+            // slave.read_interleave); RLAST retires the burst it belongs to
+            while (true) {
+                if (rvalid.read() == true) {
+                    uint32_t id = rid.read();
+                    assert(ar_table.contains(id));
+                    const AXI_REQ& r_req = ar_table[id];
+                    uint32_t& beat = r_beats[id];
+                    if (on_read_beat) {
+                        on_read_beat(r_req, beat, rdata.read().data);
+                    }
+                    uint32_t lo, hi;
+                    beat_lanes(r_req, beat, lo, hi);
+                    total_data_received += hi - lo;
+                    double now = sc_time_stamp().to_seconds() * 1e9;
+                    if (beat == 0) {
+                        stats.first_beat(READ, id, now);
+                    }
+                    beat++;
+                    if (rlast.read() == true) {
+                        stats.last_beat(READ, id, now);
+                        total_read_latency += now - r_req.issue_time;
+                        read_count++;
+                        beat = 0;
+                        ar_table.release(id);
+                        ar_released.pushed(clk);
+                        done_tail.pushed(clk);
+                        done_event.notify(SC_ZERO_TIME);
+                        req_event.notify(SC_ZERO_TIME);
+                        if (!reads_outstanding()) {
+                            break;
                         }
-                        wait();
                     }
-                    wait();
-                    ar_requests.erase(id);
-                } 
-                else { assert(0); }
+                }
+                wait();
             }
+            rready.write(false);
         }
     }
 
     void aw_process () {
         while (true) {
-            while (req_queue_empty() || req_fifo.front().type != WRITE) {
-                wait();
-            }
+            wait_until(clk, req_event, [this] { return granted(WRITE); });
+            aw_busy.set(clk, true);
+            aw_claim = claim_head();
+            req_event.notify(SC_ZERO_TIME);
 
             wait();
-            fifo_mutex.lock();
-            AXI_REQ aw_req = req_fifo.front();
-            fifo_mutex.unlock();
-            req_fifo.pop_front();
+            AXI_REQ aw_req = wr_fifo.front().req;
+            wr_fifo.pop_front();
+            aw_claim.open = false;
+            req_event.notify(SC_ZERO_TIME);
     
             {
-                // for AW_REQ and insert ar_requests
-                aw_req.id = m_awid++;
-                aw_req.size = BUS_WIDTH + randn(0, 3);
-                aw_req.len = randn(0, 31); // BL2
-                aw_requests.insert({aw_req.id, aw_req});
-                // std::cout << "[Master][AW] send aw_req { id: " << aw_req.id << ", addr: " << aw_req.addr << " [r:" << ROW_INDEX(aw_req.addr) << ",c:" << COL_INDEX(aw_req.addr) << "] , size: " << aw_req.size << ", len: " << aw_req.len << "}" << std::endl;
-
-                // send ar_request
+                // take an AWID slot for the burst
+                aw_req.id = aw_table.alloc(aw_released.unseen(clk));
+                aw_req.issue_time = sc_time_stamp().to_seconds() * 1e9;
+                aw_table[aw_req.id] = aw_req;
                 awid.write(aw_req.id);  
                 awaddr.write(aw_req.addr);
                 awsize.write(aw_req.size);
                 awlen.write(aw_req.len); 
+                awburst.write(aw_req.burst);
                 awvalid.write(true);
+                stats.issue(WRITE, aw_req.id, aw_req.issue_time, burst_bytes(aw_req), aw_req.addr);
                 wait();
             }
 
-            while (awready.read() == false) {
-                wait();
-            }
+            double valid_at = now_ns();
+            wait_until(clk, awready.value_changed_event(), [this] { return awready.read(); });
+            stats.stall(Stats::AW, cycles_since(valid_at));
 
+            stats.accept(WRITE, aw_req.id, sc_time_stamp().to_seconds() * 1e9);
             awvalid.write(false);
+            aw_busy.set(clk, false);
+            req_event.notify(SC_ZERO_TIME);
         }
     }
 
@@ -247,24 +517,29 @@ private:
         while (true) {
             wait();
 
-            while (wvalid.read() == false) {
-                wait();
-            }
+            wait_until(clk, wvalid.value_changed_event(), [this] { return wvalid.read(); });
 
             uint32_t id = wid.read();
-            AXI_REQ w_req = aw_requests[id];
-            uint32_t total_offset = ((1 << w_req.size) * (w_req.len + 1)) / (1 << BUS_WIDTH);
+            AXI_REQ w_req = aw_table[id];
+            uint32_t total_offset = burst_beats(w_req);
+            stall_unless(Stats::W, wready);
             wready.write(true);
 
-            uint32_t write_data;
+            w_buffer.resize(total_offset * BEAT_BYTES);
+            data_rng.fill(w_buffer.data(), w_buffer.size());
             for (uint32_t offset = 0; offset < total_offset; offset++) {
                 if (wvalid.read() == true) {
-                    write_data = randn(0, 0xFFFF);
-                    wdata.write(write_data);
+                    AXIBeat beat;
+                    beat.data = w_buffer.data() + offset * BEAT_BYTES;
+                    wdata.write(beat);
+                    wstrb.write(beat_strobe(w_req, offset));
+                    if (offset == 0) {
+                        stats.first_beat(WRITE, id, sc_time_stamp().to_seconds() * 1e9);
+                    }
                     if (offset == total_offset - 1) {
                         wlast.write(true);
+                        stats.last_beat(WRITE, id, sc_time_stamp().to_seconds() * 1e9);
                     }
-                    // std::cout << "[Master][id:" << id << "][offset:" << offset << "] " << std::hex << write_data << std::dec << std::endl;
                 }
                 wait();
             }
@@ -273,4 +548,31 @@ private:
             wready.write(false);
         }
     }
+
+    // a write is done, and its AW entry released, when its B is taken
+    void b_process () {
+        while (true) {
+            wait_until(clk, bvalid.value_changed_event(), [this] { return bvalid.read(); });
+            uint32_t id = bid.read();
+
+            stall_unless(Stats::B, bready);
+            bready.write(true);
+            wait();
+            bready.write(false);
+
+            if (aw_table.contains(id)) {
+                double now = now_ns();
+                total_write_latency += now - aw_table[id].issue_time;
+                write_count++;
+                stats.response(id, now);
+                done_tail.pushed(clk);
+                done_event.notify(SC_ZERO_TIME);
+                aw_table.release(id);
+                aw_released.pushed(clk);
+                req_event.notify(SC_ZERO_TIME);
+            }
+            else { assert(0); }
+            wait();
+        }
+    }
 };
\ No newline at end of file
@@ -0,0 +1,223 @@
+#pragma once
+#include <systemc>
+#include <tlm>
+#include <tlm_utils/simple_initiator_socket.h>
+#include <tlm_utils/peq_with_cb_and_phase.h>
+#include <deque>
+#include <vector>
+#include <memory>
+#include "AXICommon.hpp"
+#include "AXIPayload.hpp"
+#include "AXITable.hpp"
+#include "config.hpp"
+#include "traffic.hpp"
+#include "stats.hpp"
+
+using namespace sc_core;
+
+// Approximately-timed AXI master. The AR/R pair maps onto rd_socket and
+// AW/W/B onto wr_socket, each following the 4-phase base protocol:
+//   BEGIN_REQ  = AxVALID         END_REQ  = AxREADY
+//   BEGIN_RESP = first R beat/B  END_RESP = RLAST accepted (one RREADY per beat)
+// Up to at.max_outstanding bursts per direction may be in flight; a burst
+// takes its ID from a slot table of that size, as AXIMaster does.
+SC_MODULE (AXIMasterAT) {
+    double total_data_received = 0;
+    double total_read_latency = 0;  // ns, AR issue -> RLAST
+    double total_write_latency = 0; // ns, AW issue -> B
+    uint64_t read_count = 0;
+    uint64_t write_count = 0;
+    Stats stats; // W beats travel with the request and are not timed here
+
+    tlm_utils::simple_initiator_socket<AXIMasterAT> rd_socket;
+    tlm_utils::simple_initiator_socket<AXIMasterAT> wr_socket;
+
+    SC_HAS_PROCESS(AXIMasterAT);
+    AXIMasterAT(sc_module_name name, const config& cfg, uint32_t index = 0)
+        : sc_module(name)
+        , stats(cfg.stats.window_ns, cfg.stats.window_slots, cfg.at.max_outstanding, cfg.at.max_outstanding)
+        , rd_socket("rd_socket")
+        , wr_socket("wr_socket")
+        , clk_period(cfg.clock.period_ns, SC_NS)
+        , backpressure(cfg.traffic.mode == "backpressure")
+        , queue_depth(cfg.traffic.queue_depth)
+        , data_rng(cfg.traffic.seed, Xoshiro256::data_stream(index))
+        , rd_table(cfg.at.max_outstanding)
+        , wr_table(cfg.at.max_outstanding)
+        , peq(this, &AXIMasterAT::peq_cb)
+    {
+        // random traffic spreads over the bus targets; a point-to-point
+        // link has a single target at address 0
+        std::vector<uint64_t> bases = { 0 };
+        if (cfg.common.model == "bus") {
+            bases.clear();
+            for (const auto& region : cfg.bus.address_map) {
+                bases.push_back(region.first);
+            }
+        }
+        source = make_traffic_source(cfg, index, bases);
+
+        rd_socket.register_nb_transport_bw(this, &AXIMasterAT::nb_transport_bw);
+        wr_socket.register_nb_transport_bw(this, &AXIMasterAT::nb_transport_bw);
+
+        SC_THREAD(gen_cmd_process);
+        SC_THREAD(ar_process);
+        SC_THREAD(aw_process);
+    }
+
+private:
+    sc_time clk_period;
+    bool backpressure;
+    uint32_t queue_depth;
+    std::unique_ptr<TrafficSource> source;
+    Xoshiro256 data_rng; // write data
+    SlotTable<AXI_REQ> rd_table; // issued, response not yet complete
+    SlotTable<AXI_REQ> wr_table;
+
+    std::deque<AXI_REQ> rd_fifo;
+    std::deque<AXI_REQ> wr_fifo;
+    sc_event dequeue_event; // issue_loop took a request from a fifo
+    sc_event ar_event;
+    sc_event aw_event;
+    sc_event ar_end_req_event;
+    sc_event aw_end_req_event;
+
+    AXIPayloadPool pool;
+    tlm_utils::peq_with_cb_and_phase<AXIMasterAT> peq;
+
+    // same injection rules as AXIMaster::gen_cmd_process
+    void gen_cmd_process() {
+        AXI_REQ req;
+        double time_ns;
+
+        while (source->next(req, time_ns)) {
+            if (!backpressure) {
+                double now = sc_time_stamp().to_seconds() * 1e9;
+                if (time_ns > now) {
+                    wait(time_ns - now, sc_core::SC_NS);
+                }
+            }
+
+            split_burst(req, [this](const AXI_REQ& part) {
+                while ((part.type == READ ? rd_fifo : wr_fifo).size() >= queue_depth) {
+                    wait(dequeue_event);
+                }
+                if (part.type == READ) {
+                    rd_fifo.push_back(part);
+                    ar_event.notify();
+                } else {
+                    wr_fifo.push_back(part);
+                    aw_event.notify();
+                }
+            });
+        }
+    }
+
+    void ar_process () {
+        issue_loop(rd_socket, rd_fifo, rd_table, ar_event, ar_end_req_event);
+    }
+
+    void aw_process () {
+        issue_loop(wr_socket, wr_fifo, wr_table, aw_event, aw_end_req_event);
+    }
+
+    void issue_loop (tlm_utils::simple_initiator_socket<AXIMasterAT>& socket,
+                     std::deque<AXI_REQ>& fifo, SlotTable<AXI_REQ>& table,
+                     sc_event& ready_event, sc_event& end_req_event) {
+        while (true) {
+            while (fifo.empty() || table.full()) {
+                wait(ready_event);
+            }
+
+            AXI_REQ req = fifo.front();
+            fifo.pop_front();
+            dequeue_event.notify();
+            req.id = table.alloc();
+            req.issue_time = sc_time_stamp().to_seconds() * 1e9;
+            table[req.id] = req;
+
+            tlm::tlm_generic_payload* trans = pool.allocate();
+            AXIPayloadPool::setup(*trans, req);
+            if (req.type == WRITE) {
+                data_rng.fill(trans->get_data_ptr(), trans->get_data_length());
+            }
+            stats.issue(req.type, req.id, req.issue_time, burst_bytes(req), req.addr);
+
+            tlm::tlm_phase phase = tlm::BEGIN_REQ;
+            sc_time delay = SC_ZERO_TIME;
+            tlm::tlm_sync_enum status = socket->nb_transport_fw(*trans, phase, delay);
+
+            if (status == tlm::TLM_UPDATED && phase == tlm::END_REQ) {
+                wait(delay);
+            } else if (status == tlm::TLM_ACCEPTED) {
+                wait(end_req_event);
+            }
+            double accepted = sc_time_stamp().to_seconds() * 1e9;
+            stats.accept(req.type, req.id, accepted);
+            // AxREADY one clock after AxVALID is the no-stall handshake
+            double cycles = (accepted - req.issue_time) / (clk_period.to_seconds() * 1e9);
+            if (cycles > 1.5) {
+                stats.stall(req.type == READ ? Stats::AR : Stats::AW, static_cast<uint64_t>(cycles - 0.5));
+            }
+
+            // AxVALID drops on the edge after AxREADY
+            wait(clk_period);
+        }
+    }
+
+    tlm::tlm_sync_enum nb_transport_bw (tlm::tlm_generic_payload& trans, tlm::tlm_phase& phase, sc_time& delay) {
+        peq.notify(trans, phase, delay);
+        return tlm::TLM_ACCEPTED;
+    }
+
+    void peq_cb (tlm::tlm_generic_payload& trans, const tlm::tlm_phase& phase) {
+        if (phase == tlm::END_REQ) {
+            (trans.is_read() ? ar_end_req_event : aw_end_req_event).notify();
+        }
+        else if (phase == tlm::BEGIN_RESP) {
+            if (trans.is_read()) {
+                stats.first_beat(READ, AXIPayloadPool::request(trans).id, sc_time_stamp().to_seconds() * 1e9);
+                // RREADY stays high for one clock per beat; RLAST ends the burst
+                uint32_t total_offset = trans.get_data_length() >> BUS_WIDTH;
+                peq.notify(trans, tlm::END_RESP, total_offset * clk_period);
+            } else {
+                complete(trans);
+            }
+        }
+        else if (phase == tlm::END_RESP) {
+            complete(trans);
+        }
+        else {
+            SC_REPORT_ERROR("AXIMasterAT", "unexpected phase on backward path");
+        }
+    }
+
+    void complete (tlm::tlm_generic_payload& trans) {
+        if (trans.is_response_error()) {
+            SC_REPORT_ERROR("AXIMasterAT", "transaction failed");
+        }
+
+        AXI_REQ& req = AXIPayloadPool::request(trans);
+        double now = sc_time_stamp().to_seconds() * 1e9;
+        double latency = now - req.issue_time;
+        if (trans.is_read()) {
+            stats.last_beat(READ, req.id, now);
+            total_data_received += burst_bytes(req);
+            total_read_latency += latency;
+            read_count++;
+            rd_table.release(req.id);
+            ar_event.notify();
+        } else {
+            stats.response(req.id, now);
+            total_write_latency += latency;
+            write_count++;
+            wr_table.release(req.id);
+            aw_event.notify();
+        }
+
+        tlm::tlm_phase phase = tlm::END_RESP;
+        sc_time delay = SC_ZERO_TIME;
+        (trans.is_read() ? rd_socket : wr_socket)->nb_transport_fw(trans, phase, delay);
+        trans.release();
+    }
+};
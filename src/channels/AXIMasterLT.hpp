@@ -0,0 +1,262 @@
+#pragma once
+#include <systemc>
+#include <tlm>
+#include <tlm_utils/simple_initiator_socket.h>
+#include <tlm_utils/tlm_quantumkeeper.h>
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <vector>
+#include "AXICommon.hpp"
+#include "AXIBurst.hpp"
+#include "AXIPayload.hpp"
+#include "AXITable.hpp"
+#include "config.hpp"
+#include "traffic.hpp"
+#include "stats.hpp"
+
+using namespace sc_core;
+
+// Loosely-timed counterpart of AXIMaster: one b_transport per burst,
+// temporally decoupled through a quantum keeper. One thread walks the
+// traffic source in program order and works out, per burst, the clock edge
+// the pin master would raise AxVALID on:
+//   - the burst enters its direction's queue once the burst queue_depth
+//     places ahead of it there has issued; the generator waits for that, so
+//     a full queue holds back both directions
+//   - the slave takes an address ACCEPT_CYCLES after AxVALID, or the clock
+//     after one of the slave.max_outstanding bursts it holds in that
+//     direction finishes; AR and AW each raise the next AxVALID
+//     NEXT_ADDRESS_CYCLES later, independently
+//   - an ID is free from the clock after its RLAST / B, as are the
+//     addresses it covered: a read or write waits for every older burst of
+//     the other direction it overlaps to finish, as the pin master's hazard
+//     checks hold it
+// b_transport starts on the edge the slave takes the address and returns
+// when the burst finishes. Bursts that would issue or finish after
+// execution_time are not counted, as in the pin model.
+//
+// master.issue_policy is not modelled: the pin master's arbiter only
+// chooses between queue heads that are both ready, which moves totals by
+// well under a percent on CHECK_CONFIGS. make lt-check holds the totals to
+// the pin model's within LT_TOLERANCE (see the Makefile and AXISlaveLT.hpp
+// for the configs it leaves out).
+SC_MODULE (AXIMasterLT) {
+    double total_data_received = 0;
+    double total_read_latency = 0;  // ns, AR issue -> RLAST
+    double total_write_latency = 0; // ns, AW issue -> B
+    uint64_t read_count = 0;
+    uint64_t write_count = 0;
+    Stats stats; // issue and completion only, no handshakes to time
+
+    tlm_utils::simple_initiator_socket<AXIMasterLT> socket;
+
+    SC_HAS_PROCESS(AXIMasterLT);
+    AXIMasterLT(sc_module_name name, const config& cfg)
+        : sc_module(name)
+        , stats(cfg.stats.window_ns, cfg.stats.window_slots, cfg.master.max_outstanding_reads, cfg.master.max_outstanding_writes)
+        , socket("socket")
+        , end_time(cfg.common.execution_time, SC_NS)
+        , backpressure(cfg.traffic.mode == "backpressure")
+        , queue_depth(std::max<uint32_t>(cfg.traffic.queue_depth, 1))
+        , slave_depth(std::max<uint32_t>(cfg.slave.max_outstanding, 1))
+        , clk_period(cfg.clock.period_ns, SC_NS)
+        , clk_start(cfg.clock.start_delay_ns, SC_NS)
+        , dir{ direction(cfg.master.max_outstanding_reads), direction(cfg.master.max_outstanding_writes) }
+        , source(make_traffic_source(cfg, 0))
+        , data_rng(cfg.traffic.seed, Xoshiro256::data_stream(0))
+    {
+        SC_THREAD(issue_process);
+    }
+
+private:
+    // AxVALID -> the slave takes the address, with a slot free
+    static constexpr int ACCEPT_CYCLES = 1;
+    // the slave taking an address -> AxVALID of the next one
+    static constexpr int NEXT_ADDRESS_CYCLES = 3;
+
+    struct inflight {
+        AXI_REQ req;
+        sc_time done; // RLAST / B
+    };
+
+    struct direction {
+        SlotTable<inflight> table;    // slot = AXI ID
+        std::deque<sc_time> issued;   // AxVALID of the last queue_depth bursts
+        std::deque<inflight> history; // bursts the other direction may wait for
+        std::vector<sc_time> held;    // when the bursts the slave holds finish
+        sc_time next_grant;           // address channel free from this edge
+
+        explicit direction (uint32_t outstanding) : table(outstanding) {}
+    };
+
+    sc_time end_time;
+    bool backpressure; // issue back to back instead of at source times
+    uint32_t queue_depth;
+    uint32_t slave_depth; // bursts per direction the slave accepts
+    sc_time clk_period;
+    sc_time clk_start;
+    direction dir[2]; // by READ / WRITE
+
+    std::unique_ptr<TrafficSource> source;
+    Xoshiro256 data_rng; // write data
+    AXIPayloadPool pool;
+
+    // the first rising edge of the pin model clock at or after t
+    sc_time edge_at (const sc_time& t) const {
+        if (t <= clk_start) {
+            return clk_start;
+        }
+        uint64_t edges = ((t - clk_start).value() + clk_period.value() - 1) / clk_period.value();
+        return clk_start + clk_period * static_cast<double>(edges);
+    }
+
+    void issue_process () {
+        tlm_utils::tlm_quantumkeeper qk;
+        qk.reset();
+
+        // edge the generator's last push is seen on; pushes are in order
+        sc_time seen = edge_at(SC_ZERO_TIME);
+        AXI_REQ next;
+        double time_ns;
+        while (seen < end_time && source->next(next, time_ns)) {
+            if (!backpressure) {
+                seen = std::max(seen, edge_at(sc_time(time_ns, SC_NS)));
+            }
+            split_burst(next, [&](const AXI_REQ& part) {
+                if (seen < end_time) {
+                    issue(part, seen);
+                }
+            });
+
+            qk.set(seen - sc_time_stamp());
+            // no sync past the end: the run stops there and the drain below
+            // would never happen
+            if (qk.need_sync() && seen < end_time) {
+                qk.sync();
+            }
+        }
+
+        // drain: only bursts the pin-level model would have finished count
+        for (uint32_t type = READ; type <= WRITE; type++) {
+            retire(type, end_time);
+        }
+    }
+
+    // queue, issue and send one burst; seen moves on as the generator does
+    void issue (AXI_REQ req, sc_time& seen) {
+        direction& d = dir[req.type];
+        direction& other = dir[req.type == READ ? WRITE : READ];
+
+        // a full queue stalls the generator until its head issues, and the
+        // push after that is seen on the next edge
+        if (d.issued.size() >= queue_depth) {
+            seen = std::max(seen, d.issued.front() + clk_period);
+            d.issued.pop_front();
+        }
+
+        // drop what has finished for anything the generator can still push
+        for (direction* h : { &d, &other }) {
+            while (!h->history.empty() && h->history.front().done + clk_period <= seen) {
+                h->history.pop_front();
+            }
+        }
+
+        sc_time grant = std::max(seen, d.next_grant);
+        for (const inflight& r : other.history) {
+            if (bursts_overlap(req, r.req)) {
+                grant = std::max(grant, r.done + clk_period);
+            }
+        }
+        retire(req.type, grant - clk_period);
+        while (d.table.full()) {
+            grant = std::max(grant, earliest(d.table) + clk_period);
+            retire(req.type, grant - clk_period);
+        }
+
+        sc_time valid = grant + clk_period;
+        if (valid >= end_time) {
+            // never issues: it keeps its queue place and holds back
+            // whatever overlaps it or queues behind it
+            d.next_grant = end_time;
+            d.issued.push_back(end_time);
+            d.history.push_back({ req, end_time });
+            return;
+        }
+        d.issued.push_back(valid);
+
+        // the slave frees a slot on the edge the burst finishes and takes
+        // the next address on the clock after
+        sc_time accept = valid + ACCEPT_CYCLES * clk_period;
+        d.held.erase(std::remove_if(d.held.begin(), d.held.end(),
+                                    [&](const sc_time& t) { return t + clk_period <= accept; }),
+                     d.held.end());
+        while (d.held.size() >= slave_depth) {
+            auto first = std::min_element(d.held.begin(), d.held.end());
+            accept = std::max(accept, *first + clk_period);
+            d.held.erase(first);
+        }
+        d.next_grant = accept + (NEXT_ADDRESS_CYCLES - 1) * clk_period;
+
+        req.id = d.table.alloc();
+        req.issue_time = valid.to_seconds() * 1e9;
+        stats.issue(req.type, req.id, req.issue_time, burst_bytes(req), req.addr);
+        tlm::tlm_generic_payload& trans = *pool.allocate();
+        AXIPayloadPool::setup(trans, req);
+        if (req.type == WRITE) {
+            data_rng.fill(trans.get_data_ptr(), trans.get_data_length());
+        }
+
+        sc_time delay = accept - sc_time_stamp();
+        socket->b_transport(trans, delay);
+        bool failed = trans.is_response_error();
+        trans.release();
+        if (failed) {
+            SC_REPORT_ERROR("AXIMasterLT", "b_transport failed");
+            sc_core::sc_stop();
+            return;
+        }
+        sc_time done = sc_time_stamp() + delay;
+        d.table[req.id] = { req, done };
+        d.history.push_back({ req, done });
+        d.held.push_back(done);
+    }
+
+    sc_time earliest (SlotTable<inflight>& table) const {
+        sc_time first = SC_ZERO_TIME;
+        bool found = false;
+        for (uint32_t s = 0; s < table.capacity(); s++) {
+            if (table.contains(s) && (!found || table[s].done < first)) {
+                first = table[s].done;
+                found = true;
+            }
+        }
+        return first;
+    }
+
+    // completes, in finishing order, every burst done by now
+    void retire (uint32_t type, const sc_time& now) {
+        SlotTable<inflight>& table = dir[type].table;
+        while (!table.empty() && earliest(table) <= now) {
+            sc_time first = earliest(table);
+            uint32_t id = 0;
+            while (!table.contains(id) || table[id].done != first) {
+                id++;
+            }
+            const AXI_REQ& req = table[id].req;
+            double done_ns = first.to_seconds() * 1e9;
+            double latency = done_ns - req.issue_time;
+            if (type == READ) {
+                stats.last_beat(READ, id, done_ns);
+                total_data_received += burst_bytes(req);
+                total_read_latency += latency;
+                read_count++;
+            } else {
+                stats.response(id, done_ns);
+                total_write_latency += latency;
+                write_count++;
+            }
+            table.release(id);
+        }
+    }
+};
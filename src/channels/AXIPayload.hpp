@@ -0,0 +1,103 @@
+#pragma once
+#include <tlm>
+#include <vector>
+#include <algorithm>
+#include "AXICommon.hpp"
+#include "AXIBurst.hpp"
+
+// AXI attributes that have no generic payload field (id, size, len, burst,
+// issue time) ride along as a sticky extension, together with the burst
+// buffer the data pointer refers to. The buffer holds one BEAT_BYTES slot
+// per beat, laid out as the beat appears on the bus. For narrow or
+// unaligned beats, the byte enables mark the lanes that carry data.
+struct AXIExtension : tlm::tlm_extension<AXIExtension> {
+    AXI_REQ req;
+    std::vector<unsigned char> buffer;
+    std::vector<unsigned char> byte_enable;
+
+    tlm::tlm_extension_base* clone() const override {
+        return new AXIExtension(*this);
+    }
+
+    void copy_from(const tlm::tlm_extension_base& ext) override {
+        req = static_cast<const AXIExtension&>(ext).req;
+    }
+};
+
+// Free-list memory manager so deep outstanding queues do not allocate a
+// payload (and its burst buffer) per transaction.
+class AXIPayloadPool : public tlm::tlm_mm_interface {
+public:
+    ~AXIPayloadPool () {
+        for (tlm::tlm_generic_payload* trans : pool) {
+            delete trans;
+        }
+    }
+
+    tlm::tlm_generic_payload* allocate () {
+        tlm::tlm_generic_payload* trans;
+        if (free_list.empty()) {
+            trans = new tlm::tlm_generic_payload(this);
+            trans->set_extension(new AXIExtension);
+            pool.push_back(trans);
+        } else {
+            trans = free_list.back();
+            free_list.pop_back();
+        }
+        trans->acquire();
+        return trans;
+    }
+
+    void free (tlm::tlm_generic_payload* trans) override {
+        free_list.push_back(trans);
+    }
+
+    // fill the payload for one burst described by req
+    static void setup (tlm::tlm_generic_payload& trans, const AXI_REQ& req) {
+        AXIExtension* ext = trans.get_extension<AXIExtension>();
+        uint32_t bytes = beats(req) << BUS_WIDTH;
+        ext->req = req;
+        ext->buffer.resize(bytes);
+
+        // full-width aligned INCR/WRAP bursts use every lane
+        bool every_lane = req.size == BUS_WIDTH && (req.addr & (BEAT_BYTES - 1)) == 0;
+        if (!every_lane) {
+            ext->byte_enable.assign(bytes, 0x00);
+            for (uint32_t n = 0; n < beats(req); n++) {
+                uint32_t lo, hi;
+                beat_lanes(req, n, lo, hi);
+                std::fill(ext->byte_enable.begin() + (n << BUS_WIDTH) + lo, ext->byte_enable.begin() + (n << BUS_WIDTH) + hi, 0xFF);
+            }
+        }
+
+        trans.set_command(req.type == READ ? tlm::TLM_READ_COMMAND : tlm::TLM_WRITE_COMMAND);
+        trans.set_address(req.addr);
+        trans.set_data_ptr(ext->buffer.data());
+        trans.set_data_length(bytes);
+        trans.set_streaming_width(bytes);
+        trans.set_byte_enable_ptr(every_lane ? nullptr : ext->byte_enable.data());
+        trans.set_byte_enable_length(every_lane ? 0 : bytes);
+        trans.set_dmi_allowed(false);
+        trans.set_response_status(tlm::TLM_INCOMPLETE_RESPONSE);
+    }
+
+    static AXI_REQ& request (tlm::tlm_generic_payload& trans) {
+        return trans.get_extension<AXIExtension>()->req;
+    }
+
+    // the burst as a target sees it: at the payload address, which a bus
+    // may have translated into the target's own window
+    static AXI_REQ target_request (tlm::tlm_generic_payload& trans) {
+        AXI_REQ req = request(trans);
+        req.addr = static_cast<uint32_t>(trans.get_address());
+        return req;
+    }
+
+    static uint32_t beats (const AXI_REQ& req) {
+        return burst_beats(req);
+    }
+
+private:
+    std::vector<tlm::tlm_generic_payload*> pool;
+    std::vector<tlm::tlm_generic_payload*> free_list;
+};
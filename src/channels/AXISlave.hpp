@@ -1,15 +1,30 @@
 #pragma once
 #include <systemc>
-#include <deque>
+#include <vector>
 #include <string>
 #include <iostream>
-#include <unordered_map>
+#include <algorithm>
 #include "AXICommon.hpp"
+#include "AXIHandshake.hpp"
+#include "AXIBurst.hpp"
+#include "AXITable.hpp"
+#include "config.hpp"
+#include "dram.hpp"
+#include "write_buffer.hpp"
+#include "prefetch.hpp"
+#include "memory.hpp"
+#include "checkpoint.hpp"
 
 using namespace sc_core;
 
 SC_MODULE (AXISlave) {
     double total_data_written = 0;
+    uint64_t reorder_count = 0; // bursts served ahead of an older AR
+    uint64_t interleaved_beats = 0; // R beats sent while another burst was part way
+    DRAMModel dram_model;
+    WriteBuffer write_buffer; // in front of dram_model
+    Prefetcher prefetcher;    // in front of write_buffer
+    SparseMemory memory;
 
     sc_in<bool>      clk;
         
@@ -20,12 +35,13 @@ SC_MODULE (AXISlave) {
     sc_in<uint32_t>   araddr;    // master -> slave
     sc_in<uint32_t>   arsize;    // master -> slave
     sc_in<uint32_t>   arlen;     // master -> slave
+    sc_in<uint32_t>   arburst;   // master -> slave
 
     // R channel
     sc_out<bool>      rvalid;    // slave  -> master
     sc_in<bool>       rready;    // master -> slave
     sc_out<uint32_t>  rid;       // slave  -> master
-    sc_out<uint32_t>  rdata;     // slave  -> master
+    sc_out<AXIBeat>   rdata;     // slave  -> master
     sc_out<bool>      rlast;     // slave  -> master
 
     // AW channel
@@ -35,24 +51,51 @@ SC_MODULE (AXISlave) {
     sc_in<uint32_t>   awaddr;    // master -> slave
     sc_in<uint32_t>   awsize;    // master -> slave
     sc_in<uint32_t>   awlen;     // master -> slave
+    sc_in<uint32_t>   awburst;   // master -> slave
 
     // W channel
     sc_out<bool>      wvalid;
     sc_in<bool>       wready;
     sc_out<uint32_t>  wid;
-    sc_in<uint32_t>   wdata;
+    sc_in<AXIBeat>    wdata;
+    sc_in<AXIStrobe>  wstrb;
     sc_in<bool>       wlast;     // slave  -> master
 
-    // // B channel
-    // sc_out<bool>     bvalid_m;
-    // sc_in<bool>      bready_m;
-    // sc_in<uint32_t>  bresp_m;
+    // B channel
+    sc_out<bool>      bvalid;    // slave  -> master
+    sc_in<bool>       bready;    // master -> slave
+    sc_out<uint32_t>  bid;       // slave  -> master
+    sc_out<uint32_t>  bresp;     // slave  -> master
+
+    SC_HAS_PROCESS(AXISlave);
+    AXISlave(sc_module_name name, const config& cfg)
+        : sc_module(name)
+        , dram_model(cfg)
+        , write_buffer(cfg, dram_model)
+        , prefetcher(cfg, write_buffer, dram_model)
+        , memory(cfg)
+        , reorder_window(cfg.slave.reorder_window)
+        , read_interleave(cfg.slave.read_interleave)
+        , ack_on_commit(cfg.slave.write_ack == "commit")
+        , ar_table(cfg.slave.max_outstanding)
+        , aw_table(cfg.slave.max_outstanding)
+        , aw_fifo(cfg.slave.max_outstanding)
+    {
+        if (read_interleave == 0) {
+            throw std::invalid_argument("slave.read_interleave must be at least 1");
+        }
+        ar_fifo.reserve(ar_table.capacity());
+        r_active.reserve(read_interleave);
+        b_queue.reserve(aw_table.capacity());
 
-    SC_CTOR(AXISlave) {
         SC_THREAD(ar_process);
         sensitive << clk.pos();
 
-        SC_THREAD(r_process);
+        if (read_interleave > 1) {
+            SC_THREAD(r_interleave_process);
+        } else {
+            SC_THREAD(r_process);
+        }
         sensitive << clk.pos();
 
         SC_THREAD(aw_process);
@@ -61,58 +104,231 @@ SC_MODULE (AXISlave) {
         SC_THREAD(w_process);
         sensitive << clk.pos();
 
+        SC_THREAD(b_process);
+        sensitive << clk.pos();
+
         arready.initialize(false);
+        bvalid.initialize(false);
         rvalid.initialize(false);
         rlast.initialize(false);
+        rdata.initialize(AXIBeat());
         // wlast.initialize(false);
+    }
+
+    // no burst accepted and not yet answered as of this edge
+    bool drained () const {
+        return ar_table.empty() && ar_released.unseen(clk) == 0
+            && aw_table.empty() && aw_released.unseen(clk) == 0;
+    }
+
+    // DRAM and memory state plus counters; only taken drained
+    void save (CheckpointWriter& out) const {
+        out.tag("slave");
+        dram_model.save(out);
+        write_buffer.save(out);
+        prefetcher.save(out);
+        memory.save(out);
+        ar_table.save(out);
+        aw_table.save(out);
+        out.put(total_data_written);
+        out.put(reorder_count);
+        out.put(interleaved_beats);
+    }
+
+    void restore (CheckpointReader& in) {
+        in.expect("slave");
+        dram_model.restore(in);
+        write_buffer.restore(in);
+        prefetcher.restore(in);
+        memory.restore(in);
+        ar_table.restore(in);
+        aw_table.restore(in);
+        in.get(total_data_written);
+        in.get(reorder_count);
+        in.get(interleaved_beats);
+    }
+
+private:
+
+    uint32_t reorder_window; // 1 = in-order
+    uint32_t read_interleave; // bursts sharing the R channel, 1 = one at a time
+    bool ack_on_commit;      // B after the DRAM write instead of after WLAST
+    // accepted bursts, until their RLAST or B; a full table holds AxREADY low
+    SlotTable<AXI_REQ> ar_table;
+    SlotTable<AXI_REQ> aw_table;
+    std::vector<uint32_t> ar_fifo; // ar_table slots, oldest first
+    RingQueue<uint32_t> aw_fifo;   // aw_table slots waiting for W
+    EdgeTail ar_tail;              // pushed to ar_fifo on this edge
+    EdgeTail aw_tail;              // pushed to aw_fifo on this edge
+    EdgeTail ar_released;          // ar_table slots freed on this edge
+    EdgeTail aw_released;          // aw_table slots freed on this edge
+    sc_event ar_fifo_event;
+    sc_event aw_fifo_event;
+    sc_event ar_free_event;
+    sc_event aw_free_event;
+
+    // read_interleave > 1: the bursts on the R channel, distinct IDs
+    struct r_burst {
+        uint32_t slot;
+        double ready;  // ns, data available
+        uint32_t beat; // beats sent so far
+    };
+    std::vector<r_burst> r_active;
+    size_t r_turn = 0; // where the round robin over r_active goes on
+
+    // writes waiting for their B, each due at ready (ns)
+    struct b_entry {
+        uint32_t slot;
+        double ready;
+    };
+    std::vector<b_entry> b_queue;
+    EdgeTail b_tail;               // pushed to b_queue on this edge
+    sc_event b_event;
+
+    // the burst w_process takes; its last beat is committed to the
+    // prefetcher and write buffer before r_process touches them on that edge
+    AXI_REQ w_req;
+    bool w_open = false;
+    double w_committed_at = -1;
+    double w_committed_ready = 0; // when that bank write finishes
+    // beats that straddle a memory page are copied here, alternating so
+    // the master can still sample one while the next is filled
+    uint8_t r_staging[2][BEAT_BYTES];
+    uint32_t r_staging_next = 0;
+
+    // the beat at addr, served in place when it sits in one page
+    AXIBeat read_beat (uint64_t addr) {
+        AXIBeat beat;
+        beat.data = memory.view(addr, BEAT_BYTES);
+        if (!beat.data) {
+            uint8_t* staging = r_staging[r_staging_next ^= 1];
+            memory.read(addr, staging, BEAT_BYTES);
+            beat.data = staging;
+        }
+        return beat;
+    }
+
+    double now_ns () const {
+        return sc_time_stamp().to_seconds() * 1e9;
+    }
+
+    // the ARs r_process may see: those queued before this edge
+    size_t ar_visible () const {
+        return ar_fifo.size() - ar_tail.unseen(clk);
+    }
+
+    std::vector<uint32_t>::iterator window_end () {
+        return ar_visible() > reorder_window ? ar_fifo.begin() + reorder_window : ar_fifo.begin() + ar_visible();
+    }
+
+    // a table slot was free before this edge
+    bool slot_free (const SlotTable<AXI_REQ>& table, const EdgeTail& released) const {
+        return table.capacity() - table.size() > released.unseen(clk);
+    }
+
+    // WLAST is taken on this edge and w_process is, or was, about to see it
+    bool wlast_taken () {
+        return w_open && wready.read() && wlast.read();
+    }
+
+    // posted write: commit to the write buffer without stalling W; the
+    // prefetcher drops the lines it touches
+    void commit_write () {
+        if (w_committed_at != now_ns()) {
+            w_committed_at = now_ns();
+            w_committed_ready = prefetcher.write(w_req, now_ns());
+        }
+    }
 
-        dram.resize(16, std::vector<uint32_t>(16384, 0x0));
-        int data = 0;
-        for (int i = 0; i < 16; i++) {
-            for (int j = 0; j < 16384; j++) {
-                dram[i][j] = data++;
+    // FCFS: the oldest AR. FR-FCFS: the oldest AR within the first
+    // reorder_window entries that hits an open row, else the oldest AR.
+    // An entry is only eligible when no older AR with the same id is still
+    // queued, which keeps AXI same-ID ordering.
+    std::vector<uint32_t>::iterator pick_ar () {
+        auto head = ar_fifo.begin();
+        if (!dram_model.row_hit_first()) {
+            return head;
+        }
+        for (auto it = head; it != window_end(); ++it) {
+            if (!dram_model.row_hit(ar_table[*it].addr)) {
+                continue;
+            }
+            uint32_t id = ar_table[*it].id;
+            if (std::find_if(head, it, [this, id](uint32_t s) { return ar_table[s].id == id; }) != it) {
+                continue;
             }
+            return it;
         }
+        return head;
     }
 
-private:
+    // open rows for the other queued ARs in banks that are idle right now
+    void prepare_queued (uint32_t picked) {
+        for (auto it = ar_fifo.begin(); it != window_end(); ++it) {
+            if (*it != picked) {
+                dram_model.prepare(ar_table[*it].addr, now_ns());
+            }
+        }
+    }
 
-    // ar channel parameters
-    std::deque<uint32_t> ar_fifo;
-    std::deque<uint32_t> aw_fifo;
-    std::unordered_map<uint32_t, AR_REQ> ar_requests;
-    std::unordered_map<uint32_t, AXI_REQ> aw_requests;
-    std::vector<std::vector<uint32_t>> dram;
-    uint32_t curr_row = 0;
+    bool r_started (uint32_t slot) const {
+        return std::any_of(r_active.begin(), r_active.end(), [slot](const r_burst& b) { return b.slot == slot; });
+    }
+
+    // pick_ar for the interleaving R channel, over the ARs queued before
+    // this edge: bursts already on it are skipped, and so is any AR with an
+    // older one of its ID still queued or on the channel, so no two bursts
+    // there share an ID
+    std::vector<uint32_t>::iterator pick_interleaved () {
+        auto visible = ar_fifo.begin() + ar_visible();
+        auto first = visible;
+        for (auto it = ar_fifo.begin(); it != visible; ++it) {
+            uint32_t id = ar_table[*it].id;
+            if (r_started(*it) || std::find_if(ar_fifo.begin(), it, [this, id](uint32_t s) { return ar_table[s].id == id; }) != it) {
+                continue;
+            }
+            if (!dram_model.row_hit_first() || it >= window_end()) {
+                return first != visible ? first : it;
+            }
+            if (dram_model.row_hit(ar_table[*it].addr)) {
+                return it;
+            }
+            if (first == visible) {
+                first = it;
+            }
+        }
+        return first;
+    }
 
     void ar_process () {
         while (true) {
             wait();
-            while (arvalid.read() == false) {
-                wait();
-            }
+            wait_until(clk, arvalid.value_changed_event(), [this] { return arvalid.read(); });
+            wait_until(clk, ar_free_event, [this] { return slot_free(ar_table, ar_released); });
 
             {
-                // read ar_request and insert AR request map
+                // read ar_request into a free slot
                 uint32_t addr = araddr.read();
                 uint32_t size = arsize.read();
                 uint32_t len = arlen.read();
                 uint32_t id = arid.read();
-                AR_REQ ar_req;
-                ar_req.arid = id;
-                ar_req.araddr = addr;
-                ar_req.arsize = size;
-                ar_req.arlen = len;
-                ar_requests.insert({id, ar_req});
-                ar_fifo.push_back(id);
-                // std::cout << "[Slave ][AR] recv ar_req { arid: " << id << ", araddr: " << addr <<  ", arsize: " << size << ", arlen: " << len << "}" << std::endl;
+                AXI_REQ ar_req;
+                ar_req.type = READ;
+                ar_req.id = id;
+                ar_req.addr = addr;
+                ar_req.size = size;
+                ar_req.len = len;
+                ar_req.burst = arburst.read();
+                uint32_t slot = ar_table.alloc(ar_released.unseen(clk));
+                ar_table[slot] = ar_req;
+                ar_fifo.push_back(slot);
+                ar_tail.pushed(clk);
+                ar_fifo_event.notify(SC_ZERO_TIME);
             }
             arready.write(true);
             wait();
 
-            while (arvalid.read() == false) {
-                wait();
-            }
+            wait_until(clk, arvalid.value_changed_event(), [this] { return arvalid.read(); });
 
             arready.write(false);
         }
@@ -120,43 +336,37 @@ private:
 
     void r_process () {
         while (true) {
-            while (ar_fifo.empty()) {
-                wait();
+            wait_until(clk, ar_fifo_event, [this] { return ar_visible() > 0; });
+            if (wlast_taken()) {
+                commit_write();
             }
 
             {
-                // read data from dram and send through rdata
-                uint32_t id = ar_fifo.front();
-                if (ar_requests.find(id) != ar_requests.end()) {
-
-                    AR_REQ ar_req = ar_requests[id];
-                    uint32_t row = ROW_INDEX(ar_req.araddr);
-                    uint32_t col = COL_INDEX(ar_req.araddr);
-
-                    // address range check
-                    if (row >= dram.size() || col + ar_req.arsize * ar_req.arlen >= dram[0].size()) {
-                        std::cout << "row: " << row << ", col: " << col << std::endl;
-                        SC_REPORT_ERROR("AXISlave", "Address out of bounds!");
-                        sc_core::sc_stop();
-                        return;
-                    }
+                // read data from memory and send through rdata
+                auto pick = pick_ar();
+                if (pick != ar_fifo.begin()) {
+                    reorder_count++;
+                }
+                uint32_t slot = *pick;
+                if (ar_table.contains(slot)) {
+
+                    AXI_REQ ar_req = ar_table[slot];
 
                     {
-                        if (curr_row != row) {
-                            wait(500, sc_core::SC_NS);
+                        double ready = prefetcher.read(ar_req, now_ns());
+                        prepare_queued(slot);
+                        if (ready > now_ns()) {
+                            wait(ready - now_ns(), sc_core::SC_NS);
                         }
-                        curr_row = row;
                     }
 
-                    rid.write(ar_req.arid);
+                    rid.write(ar_req.id);
                     rvalid.write(true);
                     
-                    uint32_t total_offset = ((1 << ar_req.arsize) * (ar_req.arlen + 1)) >> BUS_WIDTH;
+                    uint32_t total_offset = burst_beats(ar_req);
                     for (uint32_t offset = 0; offset < total_offset; offset++) {
-                        while (rready.read() == false) {
-                            wait();
-                        }
-                        rdata.write(dram[row][col + offset]);
+                        wait_until(clk, rready.value_changed_event(), [this] { return rready.read(); });
+                        rdata.write(read_beat(beat_address(ar_req, offset) & ~uint64_t(BEAT_BYTES - 1)));
                         if (offset == total_offset - 1) {
                             rlast.write(true);
                         }
@@ -165,8 +375,10 @@ private:
 
                     {
                         // AR request done, remove from list
-                        ar_fifo.pop_front();
-                        ar_requests.erase(id);
+                        ar_fifo.erase(std::find(ar_fifo.begin(), ar_fifo.end(), slot));
+                        ar_table.release(slot);
+                        ar_released.pushed(clk);
+                        ar_free_event.notify(SC_ZERO_TIME);
                     }
 
                     rlast.write(false);
@@ -177,34 +389,124 @@ private:
         }
     }
 
-    void aw_process () {
+    // R with read_interleave > 1: up to that many bursts are started at
+    // once, and each beat goes to the next of them, round robin, whose data
+    // is ready, so a burst waiting on its row does not hold the channel.
+    // rid/rdata/rlast go out with RVALID and a beat is taken on an edge
+    // that sees RREADY.
+    void r_interleave_process () {
+        bool presented = false; // a beat is on the channel
+        size_t cur = 0;         // its r_active entry
+        uint32_t last_slot = UINT32_MAX; // burst of the last beat while unfinished
         while (true) {
+            if (wlast_taken()) {
+                commit_write();
+            }
+            while (r_active.size() < read_interleave) {
+                auto pick = pick_interleaved();
+                if (pick == ar_fifo.begin() + ar_visible()) {
+                    break;
+                }
+                if (pick != std::find_if(ar_fifo.begin(), ar_fifo.end(), [this](uint32_t s) { return !r_started(s); })) {
+                    reorder_count++;
+                }
+                r_active.push_back({ *pick, prefetcher.read(ar_table[*pick], now_ns()), 0 });
+                prepare_queued(*pick);
+            }
+
+            if (!presented) {
+                // in sc_time, so a ready time a rounding error past now
+                // does not turn into a zero wait
+                sc_time now = sc_time_stamp();
+                size_t n = r_active.size();
+                for (size_t i = 0; i < n && !presented; i++) {
+                    size_t k = (r_turn + i) % n;
+                    if (sc_time(r_active[k].ready, sc_core::SC_NS) <= now) {
+                        cur = k;
+                        presented = true;
+                    }
+                }
+                if (!presented) {
+                    rvalid.write(false);
+                    rlast.write(false);
+                    if (r_active.empty()) {
+                        wait_until(clk, ar_fifo_event, [this] { return ar_visible() > 0; });
+                        continue;
+                    }
+                    double ready = std::min_element(r_active.begin(), r_active.end(),
+                                                    [](const r_burst& a, const r_burst& b) { return a.ready < b.ready; })->ready;
+                    sc_time delay = sc_time(ready, sc_core::SC_NS) - now;
+                    if (r_active.size() < read_interleave) {
+                        wait(delay, ar_fifo_event);
+                    } else {
+                        wait(delay);
+                    }
+                    // pins change on a rising edge, not when the data is ready
+                    if (!clk.posedge()) {
+                        wait(clk.posedge_event());
+                    }
+                    continue;
+                }
+
+                r_burst& b = r_active[cur];
+                const AXI_REQ& ar_req = ar_table[b.slot];
+                if (last_slot != UINT32_MAX && b.slot != last_slot) {
+                    interleaved_beats++;
+                }
+                last_slot = b.slot;
+                r_turn = cur + 1;
+                rid.write(ar_req.id);
+                rdata.write(read_beat(beat_address(ar_req, b.beat) & ~uint64_t(BEAT_BYTES - 1)));
+                rlast.write(b.beat + 1 == burst_beats(ar_req));
+                rvalid.write(true);
+            }
+
             wait();
-            while (awvalid.read() == false) {
-                wait();
+            if (rready.read()) {
+                presented = false;
+                r_burst& b = r_active[cur];
+                if (++b.beat == burst_beats(ar_table[b.slot])) {
+                    ar_fifo.erase(std::find(ar_fifo.begin(), ar_fifo.end(), b.slot));
+                    ar_table.release(b.slot);
+                    ar_released.pushed(clk);
+                    ar_free_event.notify(SC_ZERO_TIME);
+                    r_active.erase(r_active.begin() + cur);
+                    r_turn = cur;
+                    last_slot = UINT32_MAX;
+                }
             }
+        }
+    }
+
+    void aw_process () {
+        while (true) {
+            wait();
+            wait_until(clk, awvalid.value_changed_event(), [this] { return awvalid.read(); });
+            wait_until(clk, aw_free_event, [this] { return slot_free(aw_table, aw_released); });
 
             {
-                // read aw_request and insert aw request map
+                // read aw_request into a free slot
                 uint32_t addr = awaddr.read();
                 uint32_t size = awsize.read();
                 uint32_t len = awlen.read();
                 uint32_t id = awid.read();
                 AXI_REQ aw_req;
+                aw_req.type = WRITE;
                 aw_req.id = id;
                 aw_req.addr = addr;
                 aw_req.size = size;
                 aw_req.len = len;
-                aw_requests.insert({id, aw_req});
-                aw_fifo.push_back(id);
-                // std::cout << "[Slave ][AW] recv aw_req { awid: " << id << ", awaddr: " << addr <<  ", awsize: " << size << ", awlen: " << len << "}" << std::endl;
+                aw_req.burst = awburst.read();
+                uint32_t slot = aw_table.alloc(aw_released.unseen(clk));
+                aw_table[slot] = aw_req;
+                aw_fifo.push_back(slot);
+                aw_tail.pushed(clk);
+                aw_fifo_event.notify(SC_ZERO_TIME);
             }
             awready.write(true);
             wait();
 
-            while (awvalid.read() == false) {
-                wait();
-            }
+            wait_until(clk, awvalid.value_changed_event(), [this] { return awvalid.read(); });
 
             awready.write(false);
         }
@@ -212,27 +514,32 @@ private:
 
     void w_process () {
         while (true) {
-            while (aw_fifo.empty() == true) {
-                wait();        
-            }
+            wait_until(clk, aw_fifo_event, [this] { return aw_fifo.size() > aw_tail.unseen(clk); });
 
-            uint32_t id = aw_fifo.front();
+            uint32_t slot = aw_fifo.front();
             aw_fifo.pop_front();
-            AXI_REQ w_req = aw_requests[id];
+            w_req = aw_table[slot];
 
-            wid.write(id);
+            wid.write(w_req.id);
             wvalid.write(true);
-            while (wready.read() == true) {
-                wait();
-            }
+            wait_until(clk, wready.value_changed_event(), [this] { return !wready.read(); });
 
-            uint32_t write_data;
+            uint32_t beat = 0;
+            w_open = true;
             while (true) {
                 if (wready.read() == true) {
-                    write_data = wdata.read();
-                    total_data_written += (1 << BUS_WIDTH);
+                    uint64_t beat_addr = beat_address(w_req, beat++) & ~uint64_t(BEAT_BYTES - 1);
+                    if (wdata.read().data) {
+                        memory.write(beat_addr, wdata.read().data, wstrb.read());
+                    }
+                    total_data_written += wstrb.read().count();
                     if (wlast.read() == true) {
                         wvalid.write(false);
+                        commit_write();
+                        w_open = false;
+                        b_queue.push_back({ slot, ack_on_commit ? w_committed_ready : now_ns() });
+                        b_tail.pushed(clk);
+                        b_event.notify(SC_ZERO_TIME);
                         break;
                     }
                 }
@@ -241,4 +548,32 @@ private:
             wait();
         }
     }
+
+    // B responses go out as they fall due, which with write_ack: commit can
+    // be out of AW order since writes to different banks finish at
+    // different times
+    void b_process () {
+        while (true) {
+            wait_until(clk, b_event, [this] { return b_queue.size() > b_tail.unseen(clk); });
+
+            auto due = std::min_element(b_queue.begin(), b_queue.end() - b_tail.unseen(clk),
+                                        [](const b_entry& a, const b_entry& b) { return a.ready < b.ready; });
+            b_entry entry = *due;
+            b_queue.erase(due);
+            if (entry.ready > now_ns()) {
+                wait(entry.ready - now_ns(), sc_core::SC_NS);
+            }
+
+            bid.write(aw_table[entry.slot].id);
+            bresp.write(RESP_OKAY);
+            bvalid.write(true);
+            wait_until(clk, bready.value_changed_event(), [this] { return bready.read(); });
+
+            bvalid.write(false);
+            aw_table.release(entry.slot);
+            aw_released.pushed(clk);
+            aw_free_event.notify(SC_ZERO_TIME);
+            wait();
+        }
+    }
 };
\ No newline at end of file
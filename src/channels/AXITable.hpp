@@ -0,0 +1,139 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cassert>
+#include <algorithm>
+#include <stdexcept>
+#include "checkpoint.hpp"
+
+// Fixed-capacity containers for the pin-level transaction state. Storage is
+// sized once at elaboration, so a run allocates nothing per burst and its
+// memory stays flat however long it gets.
+
+// FIFO of at most capacity entries in a ring.
+template <typename T>
+class RingQueue {
+public:
+    explicit RingQueue (size_t capacity) : slots(std::max<size_t>(capacity, 1)) {}
+
+    bool empty () const { return count == 0; }
+    bool full () const { return count == slots.size(); }
+    size_t size () const { return count; }
+    size_t capacity () const { return slots.size(); }
+
+    T& front () {
+        assert(!empty());
+        return slots[head];
+    }
+
+    // i-th entry from the front
+    T& operator[] (size_t i) {
+        assert(i < count);
+        return slots[(head + i) % slots.size()];
+    }
+
+    const T& operator[] (size_t i) const {
+        assert(i < count);
+        return slots[(head + i) % slots.size()];
+    }
+
+    void push_back (const T& value) {
+        assert(!full());
+        slots[(head + count) % slots.size()] = value;
+        count++;
+    }
+
+    void pop_front () {
+        assert(!empty());
+        head = (head + 1) % slots.size();
+        count--;
+    }
+
+private:
+    std::vector<T> slots;
+    size_t head = 0;
+    size_t count = 0;
+};
+
+// Transactions in numbered slots. alloc() hands out a free slot number,
+// the most recently released first; a master uses it as the AXI ID, so a
+// response finds its burst by indexing with RID/BID. alloc(hidden) passes
+// over the `hidden` most recent releases, slots other threads freed on the
+// current clock edge that the caller may not see yet; released(i) tells
+// which slot the i-th most recent release freed. A checkpoint is only
+// taken with the table empty, so save() keeps just the order of the free
+// list: a restored table hands out the same IDs as the saving run did.
+template <typename T>
+class SlotTable {
+public:
+    explicit SlotTable (uint32_t capacity)
+        : entries(std::max<uint32_t>(capacity, 1))
+        , used(entries.size(), false)
+    {
+        free_slots.reserve(entries.size());
+        for (uint32_t s = entries.size(); s-- > 0; ) {
+            free_slots.push_back(s);
+        }
+    }
+
+    bool empty () const { return free_slots.size() == entries.size(); }
+    bool full () const { return free_slots.empty(); }
+    uint32_t size () const { return entries.size() - free_slots.size(); }
+    uint32_t capacity () const { return entries.size(); }
+
+    bool contains (uint32_t slot) const {
+        return slot < entries.size() && used[slot];
+    }
+
+    uint32_t alloc (uint32_t hidden = 0) {
+        assert(free_slots.size() > hidden);
+        auto it = free_slots.end() - 1 - hidden;
+        uint32_t slot = *it;
+        free_slots.erase(it);
+        used[slot] = true;
+        return slot;
+    }
+
+    uint32_t released (uint32_t i) const {
+        assert(i < free_slots.size());
+        return free_slots[free_slots.size() - 1 - i];
+    }
+
+    void release (uint32_t slot) {
+        assert(contains(slot));
+        used[slot] = false;
+        free_slots.push_back(slot);
+    }
+
+    T& operator[] (uint32_t slot) {
+        return entries[slot];
+    }
+
+    void save (CheckpointWriter& out) const {
+        assert(empty());
+        out.put(free_slots);
+    }
+
+    void restore (CheckpointReader& in) {
+        std::vector<uint32_t> saved;
+        in.get(saved);
+        std::vector<uint32_t> slots(saved);
+        std::sort(slots.begin(), slots.end());
+        for (uint32_t i = 0; i < slots.size(); i++) {
+            if (slots[i] != i) {
+                slots.clear();
+                break;
+            }
+        }
+        if (saved.size() != entries.size() || slots.size() != entries.size()) {
+            throw std::runtime_error("checkpoint slot table does not match the configured outstanding depth");
+        }
+        free_slots.swap(saved);
+        std::fill(used.begin(), used.end(), false);
+    }
+
+private:
+    std::vector<T> entries;
+    std::vector<bool> used;
+    std::vector<uint32_t> free_slots;
+};
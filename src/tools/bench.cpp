@@ -0,0 +1,265 @@
+// Simulator performance benchmark. Runs a fixed set of scenarios one at a
+// time, so they do not compete for the host, and compares them against a
+// checked-in baseline:
+//
+//   benchmark [spec.yaml] [--update]
+//
+// spec:
+//   sim: ./practice07_bus_system_sim
+//                          simulator binary
+//   base: config.yaml      config every scenario starts from
+//   output: bench_out      <scenario>/ directories and results.json
+//   baseline: bench_baseline.json
+//   repeat: 3              runs per scenario, the fastest one counts
+//   threshold: 0.10        allowed wall clock slowdown on the same host
+//   model_threshold: 0.01  allowed delta cycle growth or GB/s change
+//   scenarios:             name -> config overrides
+//     stream_read: {traffic.source: pattern, traffic.pattern.read_ratio: 1.0}
+//
+// Per scenario it records delta cycles of the kernel (from stats.json) and
+// the modeled GB/s, which do not depend on the host, and the host wall
+// clock of the whole process and simulated ns per host second, which do.
+// The baseline keeps the first pair per scenario and the second per host
+// name:
+//   {"scenarios": {name: {delta_cycles, gbps}},
+//    "hosts": {host: {name: {wall_s, sim_ns_per_s}}}}
+// A scenario fails when its delta cycles grow or its GB/s moves by more
+// than model_threshold, or, against this host's own entry, when wall
+// clock grows or simulation speed drops by more than threshold. A host
+// without an entry only gets the host-independent checks, and a metric
+// recorded as 0 is not checked. A scenario missing from the baseline
+// fails, so an empty baseline cannot pass.
+// --update rewrites the scenarios and this host's entry from this run,
+// keeping the other hosts.
+#include <yaml-cpp/yaml.h>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "process.hpp"
+
+struct scenario {
+    std::string name;
+    overrides params;
+};
+
+struct measurement {
+    int status = -1; // exit code, 0 once every repeat ran
+    double wall_s = 0;
+    double sim_ns_per_s = 0;
+    uint64_t delta_cycles = 0;
+    double gbps = 0;
+};
+
+static measurement run (const std::string& sim, const std::string& base, const std::string& dir, const scenario& s, int repeat) {
+    measurement m;
+    m.wall_s = 1e300;
+    for (int i = 0; i < repeat; i++) {
+        auto start = std::chrono::steady_clock::now();
+        pid_t pid = launch(sim, base, dir, s.params);
+        int status;
+        if (waitpid(pid, &status, 0) < 0) {
+            throw std::runtime_error("waitpid failed");
+        }
+        double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        m.status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+        if (m.status != 0) {
+            return m;
+        }
+        m.wall_s = std::min(m.wall_s, wall);
+
+        YAML::Node stats = YAML::LoadFile(dir + "/stats.json");
+        m.sim_ns_per_s = std::max(m.sim_ns_per_s, stats["kernel"]["sim_ns_per_host_second"].as<double>(0));
+        m.delta_cycles = stats["kernel"]["delta_cycles"].as<uint64_t>(0);
+        m.gbps = 0;
+        for (const auto& master : stats["masters"]) {
+            m.gbps += master.second["gbps"]["read"].as<double>(0) + master.second["gbps"]["write"].as<double>(0);
+        }
+    }
+    return m;
+}
+
+static std::string host_name () {
+    char host[256] = "";
+    gethostname(host, sizeof(host) - 1);
+    return host;
+}
+
+static void write_host (std::ostream& os, const std::vector<std::string>& names, const std::vector<double>& wall_s, const std::vector<double>& sim_ns_per_s) {
+    os << "{";
+    for (size_t i = 0; i < names.size(); i++) {
+        os << (i ? ",\n    " : "\n    ") << "\"" << names[i] << "\": {\"wall_s\": " << wall_s[i]
+           << ", \"sim_ns_per_s\": " << sim_ns_per_s[i] << "}";
+    }
+    os << "}";
+}
+
+// this run's scenarios and host entry, plus the other hosts of `previous`
+static void write_json (std::ostream& os, const std::vector<scenario>& scenarios, const std::vector<measurement>& results, const YAML::Node& previous) {
+    std::string host = host_name();
+    os << std::setprecision(10) << "{\"scenarios\": {";
+    std::vector<std::string> names;
+    std::vector<double> wall_s, sim_ns_per_s;
+    for (size_t i = 0; i < scenarios.size(); i++) {
+        const measurement& m = results[i];
+        os << (i ? ",\n  " : "\n  ") << "\"" << scenarios[i].name << "\": {\"delta_cycles\": " << m.delta_cycles
+           << ", \"gbps\": " << m.gbps << "}";
+        names.push_back(scenarios[i].name);
+        wall_s.push_back(m.wall_s);
+        sim_ns_per_s.push_back(m.sim_ns_per_s);
+    }
+    os << "},\n\"hosts\": {\n  \"" << host << "\": ";
+    write_host(os, names, wall_s, sim_ns_per_s);
+    for (const auto& other : previous["hosts"]) {
+        if (other.first.as<std::string>() == host) {
+            continue;
+        }
+        names.clear();
+        wall_s.clear();
+        sim_ns_per_s.clear();
+        for (const auto& entry : other.second) {
+            names.push_back(entry.first.as<std::string>());
+            wall_s.push_back(entry.second["wall_s"].as<double>(0));
+            sim_ns_per_s.push_back(entry.second["sim_ns_per_s"].as<double>(0));
+        }
+        os << ",\n  \"" << other.first.as<std::string>() << "\": ";
+        write_host(os, names, wall_s, sim_ns_per_s);
+    }
+    os << "}}\n";
+}
+
+// true when the scenario is within the thresholds of its baseline; `base`
+// holds the host-independent metrics, `host` this host's, if it has any
+static bool compare (const std::string& name, const measurement& m, const YAML::Node& base, const YAML::Node& host,
+                     double threshold, double model_threshold) {
+    if (!base) {
+        std::cout << "  " << name << ": not in the baseline, run `make bench-baseline`  REGRESSION" << std::endl;
+        return false;
+    }
+    bool ok = true;
+    auto check = [&](const char* metric, double now, double was, double limit, bool higher_is_worse, bool either_way) {
+        if (was <= 0) {
+            return;
+        }
+        double change = now / was - 1.0;
+        bool worse = either_way ? std::fabs(change) > limit : higher_is_worse ? change > limit : -change > limit;
+        std::cout << "  " << name << "." << metric << ": " << was << " -> " << now << " ("
+                  << std::showpos << std::fixed << std::setprecision(1) << change * 100 << "%"
+                  << std::noshowpos << std::defaultfloat << std::setprecision(6) << ")"
+                  << (worse ? "  REGRESSION" : "") << std::endl;
+        ok &= !worse;
+    };
+    check("delta_cycles", m.delta_cycles, base["delta_cycles"].as<double>(0), model_threshold, true, false);
+    // a GB/s change either way means the model changed; re-record the
+    // baseline if that was intended
+    check("gbps", m.gbps, base["gbps"].as<double>(0), model_threshold, false, true);
+    if (host) {
+        check("wall_s", m.wall_s, host["wall_s"].as<double>(0), threshold, true, false);
+        check("sim_ns_per_s", m.sim_ns_per_s, host["sim_ns_per_s"].as<double>(0), threshold, false, false);
+    }
+    return ok;
+}
+
+int main (int argc, char* argv[]) {
+    try {
+        std::string spec_path = "bench.yaml";
+        bool update = false;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--update") {
+                update = true;
+            } else {
+                spec_path = arg;
+            }
+        }
+
+        YAML::Node spec = YAML::LoadFile(spec_path);
+        std::string sim      = absolute(spec["sim"].as<std::string>("./practice07_bus_system_sim"));
+        std::string base     = absolute(spec["base"].as<std::string>("config.yaml"));
+        std::string output   = spec["output"].as<std::string>("bench_out");
+        std::string baseline = spec["baseline"].as<std::string>("bench_baseline.json");
+        int repeat           = std::max(spec["repeat"].as<int>(3), 1);
+        double threshold     = spec["threshold"].as<double>(0.10);
+        double model_threshold = spec["model_threshold"].as<double>(0.01);
+
+        std::vector<scenario> scenarios;
+        for (const auto& entry : spec["scenarios"]) {
+            scenario s;
+            s.name = entry.first.as<std::string>();
+            for (const auto& param : entry.second) {
+                s.params.push_back({ param.first.as<std::string>(), scalar(param.second) });
+            }
+            scenarios.push_back(s);
+        }
+        if (scenarios.empty()) {
+            std::cerr << "bench: no scenarios in spec" << std::endl;
+            return 1;
+        }
+        mkdir(output.c_str(), 0755);
+
+        bool failed = false;
+        std::vector<measurement> results;
+        for (const scenario& s : scenarios) {
+            std::string dir = output + "/" + s.name;
+            mkdir(dir.c_str(), 0755);
+            results.push_back(run(sim, base, dir, s, repeat));
+            const measurement& m = results.back();
+            if (m.status != 0) {
+                std::cout << "[bench] " << s.name << " exited with " << m.status << ", see " << dir << "/sim.log" << std::endl;
+                failed = true;
+                continue;
+            }
+            std::cout << "[bench] " << s.name << ": " << m.wall_s << " s, " << m.sim_ns_per_s << " sim ns/s, "
+                      << m.delta_cycles << " delta cycles, " << m.gbps << " GB/s" << std::endl;
+        }
+
+        YAML::Node reference;
+        try {
+            reference = YAML::LoadFile(baseline);
+        } catch (const YAML::Exception&) {
+            std::cout << "[bench] no baseline at " << baseline << std::endl;
+        }
+
+        std::ofstream json(output + "/results.json");
+        write_json(json, scenarios, results, YAML::Node());
+
+        if (update) {
+            if (failed) {
+                std::cerr << "bench: not updating the baseline, a scenario failed" << std::endl;
+                return 1;
+            }
+            std::ofstream out(baseline);
+            write_json(out, scenarios, results, reference);
+            std::cout << "[bench] baseline written to " << baseline << std::endl;
+            return 0;
+        }
+
+        std::string host = host_name();
+        YAML::Node host_base = reference["hosts"][host];
+        std::cout << "[bench] against " << baseline << " (delta cycles and GB/s " << model_threshold * 100 << "%";
+        if (host_base) {
+            std::cout << ", wall clock " << threshold * 100 << "% on " << host;
+        } else {
+            std::cout << "; no wall clock entry for " << host;
+        }
+        std::cout << ")" << std::endl;
+        for (size_t i = 0; i < scenarios.size(); i++) {
+            if (results[i].status == 0) {
+                failed |= !compare(scenarios[i].name, results[i], reference["scenarios"][scenarios[i].name],
+                                   host_base ? host_base[scenarios[i].name] : YAML::Node(), threshold, model_threshold);
+            }
+        }
+        std::cout << "[bench] " << (failed ? "FAILED" : "passed") << std::endl;
+        return failed ? 1 : 0;
+    } catch (const std::exception& e) {
+        std::cerr << "bench: " << e.what() << std::endl;
+        return 1;
+    }
+}
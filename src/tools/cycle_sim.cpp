@@ -0,0 +1,110 @@
+// Native cycle-based simulator for the pin model (include/cycle.hpp): the
+// same AXIMaster/AXISlave protocol and DRAM timing, without SystemC, for
+// cycle.ports independent master/slave pairs on a thread pool.
+//
+//   cycle_sim [--config path] [--threads N] [--check ref.csv] [key=value ...]
+//
+// --check compares port 0 burst by burst against the completion log of the
+// SystemC pin model (stats.completions) run with the same config, and fails
+// on the first burst whose issue or done cycle differs. make cosim runs it
+// over a fixed set of configs.
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+#include "config.hpp"
+#include "completions.hpp"
+#include "cycle.hpp"
+
+// ref sorted; both runs end at common.execution_time, so they must have
+// finished the same bursts
+static bool check (const std::vector<completion>& ref, std::vector<completion> run) {
+    std::sort(run.begin(), run.end());
+    size_t common = std::min(ref.size(), run.size());
+    for (size_t i = 0; i < common; i++) {
+        if (!(ref[i] == run[i])) {
+            std::cout << "[cycle_sim] mismatch at burst " << i << std::endl
+                      << "  systemc: " << ref[i] << std::endl
+                      << "  cycle:   " << run[i] << std::endl;
+            return false;
+        }
+    }
+    if (ref.size() != run.size()) {
+        std::cout << "[cycle_sim] mismatch: " << ref.size() << " bursts in the reference, "
+                  << run.size() << " here" << std::endl;
+        return false;
+    }
+    std::cout << "[cycle_sim] " << common << " bursts match the reference" << std::endl;
+    return true;
+}
+
+int main (int argc, char* argv[]) {
+    try {
+        std::string config_path = "./config.yaml";
+        std::string reference;
+        int threads = -1;
+        std::vector<std::string> overrides;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--config" && i + 1 < argc) {
+                config_path = argv[++i];
+            } else if (arg == "--threads" && i + 1 < argc) {
+                threads = std::stoi(argv[++i]);
+            } else if (arg == "--check" && i + 1 < argc) {
+                reference = argv[++i];
+            } else if (arg.find('=') != std::string::npos) {
+                overrides.push_back(arg);
+            } else {
+                std::cerr << "usage: " << argv[0] << " [--config <path>] [--threads N] [--check <ref.csv>] [key=value ...]" << std::endl;
+                return 1;
+            }
+        }
+
+        config_loader loader;
+        loader.load_yaml(config_path, overrides);
+        const config& cfg = loader.cfg;
+
+        CycleEngine engine(cfg);
+        auto start = std::chrono::steady_clock::now();
+        engine.run(threads >= 0 ? threads : cfg.cycle.threads);
+        double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        CycleEngine::totals sum;
+        for (uint32_t p = 0; p < engine.port_count(); p++) {
+            const CycleEngine::totals& t = engine.port_totals(p);
+            sum.read_count += t.read_count;
+            sum.write_count += t.write_count;
+            sum.read_bytes += t.read_bytes;
+            sum.written_bytes += t.written_bytes;
+            sum.total_read_latency += t.total_read_latency;
+            sum.total_write_latency += t.total_write_latency;
+            sum.reorder_count += t.reorder_count;
+        }
+        double sim_ns = cfg.common.execution_time;
+        std::cout << "[cycle_sim] " << engine.port_count() << " ports, " << sim_ns << " ns in " << wall_s << " s" << std::endl;
+        std::cout << "[cycle_sim] reads: " << sum.read_count << ", avg latency "
+                  << (sum.read_count ? sum.total_read_latency / sum.read_count : 0) << " ns, "
+                  << sum.read_bytes / sim_ns << " GB/s" << std::endl;
+        std::cout << "[cycle_sim] writes: " << sum.write_count << ", avg latency "
+                  << (sum.write_count ? sum.total_write_latency / sum.write_count : 0) << " ns, "
+                  << sum.written_bytes / sim_ns << " GB/s" << std::endl;
+        std::cout << "[cycle_sim] reordered reads: " << sum.reorder_count << std::endl;
+
+        if (!cfg.stats.completions.empty()) {
+            CompletionLog log(cfg.stats.completions, cfg.clock.start_delay_ns, cfg.clock.period_ns);
+            for (const completion& c : engine.completions(0)) {
+                log.record(c);
+            }
+        }
+
+        if (!reference.empty()) {
+            return check(CompletionLog::load(reference), engine.completions(0)) ? 0 : 1;
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "cycle_sim: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+// Helpers shared by the tools that drive the simulator binary (sweep,
+// bench): path resolution, YAML scalars as override text, and launching
+// one `sim --config <base> key=value ...` run in its own directory.
+#include <yaml-cpp/yaml.h>
+#include <string>
+#include <vector>
+#include <utility>
+#include <stdexcept>
+#include <climits>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+
+typedef std::vector<std::pair<std::string, std::string>> overrides;
+
+inline std::string absolute (const std::string& path) {
+    char buf[PATH_MAX];
+    if (!realpath(path.c_str(), buf)) {
+        throw std::runtime_error("no such file: " + path);
+    }
+    return buf;
+}
+
+inline std::string scalar (const YAML::Node& node) {
+    YAML::Emitter out;
+    out << YAML::Flow << node;
+    return out.c_str();
+}
+
+// Forks the simulator with dir as working directory, so stats and traces
+// land there; stdout and stderr go to dir/sim.log. The run always exports
+// dir/stats.json, which the tools read back. Returns the child pid.
+inline pid_t launch (const std::string& sim, const std::string& base, const std::string& dir, const overrides& p) {
+    pid_t pid = fork();
+    if (pid < 0) {
+        throw std::runtime_error("fork failed");
+    }
+    if (pid > 0) {
+        return pid;
+    }
+
+    // child
+    if (chdir(dir.c_str()) < 0) {
+        _exit(127);
+    }
+    int log = open("sim.log", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (log >= 0) {
+        dup2(log, STDOUT_FILENO);
+        dup2(log, STDERR_FILENO);
+        close(log);
+    }
+    std::vector<std::string> args = { sim, "--config", base };
+    for (const auto& kv : p) {
+        args.push_back(kv.first + "=" + kv.second);
+    }
+    args.push_back("stats.output=stats");
+    std::vector<char*> argv;
+    for (std::string& arg : args) {
+        argv.push_back(&arg[0]);
+    }
+    argv.push_back(nullptr);
+    execv(sim.c_str(), argv.data());
+    _exit(127);
+}
@@ -0,0 +1,237 @@
+// Parameter sweep driver. Expands a sweep spec into points, runs one sim
+// per point in its own output directory across the host's cores, then
+// collects every point's stats.json into one table.
+//
+//   sweep [spec.yaml]
+//
+// spec:
+//   sim: ./practice07_bus_system_sim
+//                          simulator binary
+//   base: config.yaml      config every point starts from
+//   output: sweep_out      point_<n>/ directories and results.{csv,json}
+//   jobs: 0                concurrent workers, 0 = one per core
+//   parameters:            cartesian product of every listed value
+//     clock.period_ns: [1, 2]
+//     at.max_outstanding: [4, 16]
+//   points:                and/or explicit points, run as given
+//     - {dram.scheduler: fcfs, slave.reorder_window: 1}
+//   warmup:                optional: one run up to a checkpoint first,
+//     checkpoint.at_ns: 1e6  which every point then restores from
+//
+// Each point runs as `sim --config <base> key=value ...` with the point
+// directory as working directory, so stats and traces land there; stdout
+// and stderr go to point_<n>/sim.log. With warmup, warmup/ holds the
+// warm-up run and its checkpoint, and every point gets checkpoint.restore;
+// their common.execution_time must lie past the checkpoint.
+#include <yaml-cpp/yaml.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "process.hpp"
+
+typedef overrides point;
+
+struct result {
+    int status = -1; // exit code, -1 = did not finish
+    uint64_t reads = 0;
+    uint64_t writes = 0;
+    double read_gbps = 0;
+    double write_gbps = 0;
+    double r_p50 = 0; // worst master
+    double r_p99 = 0;
+    double b_p50 = 0;
+    double b_p99 = 0;
+};
+
+static std::vector<point> expand (const YAML::Node& spec) {
+    std::vector<point> points;
+
+    YAML::Node params = spec["parameters"];
+    if (params && params.size() > 0) {
+        points.push_back({});
+        for (const auto& param : params) {
+            std::string key = param.first.as<std::string>();
+            std::vector<point> next;
+            for (const point& p : points) {
+                for (const YAML::Node& value : param.second) {
+                    point q = p;
+                    q.push_back({ key, scalar(value) });
+                    next.push_back(q);
+                }
+            }
+            points.swap(next);
+        }
+    }
+
+    for (const YAML::Node& entry : spec["points"]) {
+        point p;
+        for (const auto& param : entry) {
+            p.push_back({ param.first.as<std::string>(), scalar(param.second) });
+        }
+        points.push_back(p);
+    }
+    return points;
+}
+
+static void collect (const std::string& dir, result& r) {
+    YAML::Node stats;
+    try {
+        stats = YAML::LoadFile(dir + "/stats.json");
+    } catch (const YAML::Exception&) {
+        return;
+    }
+    for (const auto& master : stats["masters"]) {
+        const YAML::Node& m = master.second;
+        r.reads      += m["completed"]["read"].as<uint64_t>(0);
+        r.writes     += m["completed"]["write"].as<uint64_t>(0);
+        r.read_gbps  += m["gbps"]["read"].as<double>(0);
+        r.write_gbps += m["gbps"]["write"].as<double>(0);
+        r.r_p50 = std::max(r.r_p50, m["latency_ns"]["r_last"]["p50"].as<double>(0));
+        r.r_p99 = std::max(r.r_p99, m["latency_ns"]["r_last"]["p99"].as<double>(0));
+        r.b_p50 = std::max(r.b_p50, m["latency_ns"]["b_resp"]["p50"].as<double>(0));
+        r.b_p99 = std::max(r.b_p99, m["latency_ns"]["b_resp"]["p99"].as<double>(0));
+    }
+}
+
+static void write_results (const std::string& output, const std::vector<point>& points, const std::vector<result>& results) {
+    std::vector<std::string> keys;
+    for (const point& p : points) {
+        for (const auto& kv : p) {
+            if (std::find(keys.begin(), keys.end(), kv.first) == keys.end()) {
+                keys.push_back(kv.first);
+            }
+        }
+    }
+
+    std::ofstream csv(output + "/results.csv");
+    csv << "point";
+    for (const std::string& key : keys) {
+        csv << "," << key;
+    }
+    csv << ",status,reads,writes,read_gbps,write_gbps,r_p50_ns,r_p99_ns,b_p50_ns,b_p99_ns\n";
+
+    std::ofstream json(output + "/results.json");
+    json << "[";
+
+    for (size_t i = 0; i < points.size(); i++) {
+        std::map<std::string, std::string> values(points[i].begin(), points[i].end());
+        const result& r = results[i];
+
+        csv << i;
+        for (const std::string& key : keys) {
+            std::string v = values.count(key) ? values[key] : "";
+            if (v.find(',') != std::string::npos) {
+                v = "\"" + v + "\"";
+            }
+            csv << "," << v;
+        }
+        csv << "," << r.status << "," << r.reads << "," << r.writes << "," << r.read_gbps << "," << r.write_gbps
+            << "," << r.r_p50 << "," << r.r_p99 << "," << r.b_p50 << "," << r.b_p99 << "\n";
+
+        json << (i ? ",\n " : "\n ") << "{\"point\": " << i << ", \"parameters\": {";
+        bool first = true;
+        for (const auto& kv : points[i]) {
+            YAML::Emitter value;
+            value << YAML::DoubleQuoted << kv.second;
+            json << (first ? "" : ", ") << "\"" << kv.first << "\": " << value.c_str();
+            first = false;
+        }
+        json << "}, \"status\": " << r.status << ", \"reads\": " << r.reads << ", \"writes\": " << r.writes
+             << ", \"read_gbps\": " << r.read_gbps << ", \"write_gbps\": " << r.write_gbps
+             << ", \"r_p50_ns\": " << r.r_p50 << ", \"r_p99_ns\": " << r.r_p99
+             << ", \"b_p50_ns\": " << r.b_p50 << ", \"b_p99_ns\": " << r.b_p99 << "}";
+    }
+    json << "\n]\n";
+}
+
+int main (int argc, char* argv[]) {
+    try {
+        YAML::Node spec = YAML::LoadFile(argc > 1 ? argv[1] : "sweep.yaml");
+        std::string sim    = absolute(spec["sim"].as<std::string>("./practice07_bus_system_sim"));
+        std::string base   = absolute(spec["base"].as<std::string>("config.yaml"));
+        std::string output = spec["output"].as<std::string>("sweep_out");
+        long jobs = spec["jobs"].as<long>(0);
+        if (jobs <= 0) {
+            jobs = std::max(sysconf(_SC_NPROCESSORS_ONLN), 1L);
+        }
+
+        std::vector<point> points = expand(spec);
+        if (points.empty()) {
+            std::cerr << "sweep: no points in spec" << std::endl;
+            return 1;
+        }
+        mkdir(output.c_str(), 0755);
+
+        if (spec["warmup"]) {
+            std::string dir = output + "/warmup";
+            mkdir(dir.c_str(), 0755);
+            point warmup;
+            for (const auto& param : spec["warmup"]) {
+                warmup.push_back({ param.first.as<std::string>(), scalar(param.second) });
+            }
+            warmup.push_back({ "checkpoint.save", "warmup.ckpt" });
+            warmup.push_back({ "checkpoint.stop", "true" });
+            int status;
+            if (waitpid(launch(sim, base, dir, warmup), &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                std::cerr << "sweep: warm-up run failed, see " << dir << "/sim.log" << std::endl;
+                return 1;
+            }
+            std::string checkpoint = absolute(dir + "/warmup.ckpt");
+            std::cout << "[sweep] warm-up checkpoint " << checkpoint << std::endl;
+            for (point& p : points) {
+                p.push_back({ "checkpoint.restore", checkpoint });
+            }
+        }
+
+        std::vector<result> results(points.size());
+        std::map<pid_t, size_t> running;
+        size_t next = 0;
+        size_t done = 0;
+        while (done < points.size()) {
+            while (next < points.size() && static_cast<long>(running.size()) < jobs) {
+                std::string dir = output + "/point_" + std::to_string(next);
+                mkdir(dir.c_str(), 0755);
+                running[launch(sim, base, dir, points[next])] = next;
+                next++;
+            }
+
+            int status;
+            pid_t pid = wait(&status);
+            if (pid < 0) {
+                break;
+            }
+            auto it = running.find(pid);
+            if (it == running.end()) {
+                continue;
+            }
+            size_t i = it->second;
+            running.erase(it);
+            results[i].status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+            collect(output + "/point_" + std::to_string(i), results[i]);
+            done++;
+            std::cout << "[sweep] " << done << "/" << points.size() << " point_" << i
+                      << " status " << results[i].status << std::endl;
+        }
+
+        write_results(output, points, results);
+        std::cout << "[sweep] results in " << output << "/results.{csv,json}" << std::endl;
+
+        for (const result& r : results) {
+            if (r.status != 0) {
+                return 1;
+            }
+        }
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "sweep: " << e.what() << std::endl;
+        return 1;
+    }
+}
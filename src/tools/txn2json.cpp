@@ -0,0 +1,272 @@
+// Converts the transaction log of a run (stats.transactions, see
+// include/recorder.hpp) into Chrome trace event JSON, for Perfetto
+// (ui.perfetto.dev) or chrome://tracing:
+//
+//   txn2json <in.txn> <out.json> [--lanes]
+//
+// Every master is a process with these tracks:
+//   AR / AW   one slice per burst from issue to address accept
+//   R / W     one slice per burst from first to last data beat
+//   B         an instant per write response
+//   read id N / write id N
+//             one slice per burst from issue to RLAST or B
+// Slices of one track never overlap: a burst that starts while the track
+// is busy goes to the next free one ("AR #1", ...). --lanes does the same
+// for the ID tracks ("read lane N"), for the AT/LT/bus masters, which give
+// every burst a new ID. Bursts still open at the end of the run are left
+// out.
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include "recorder.hpp"
+
+// a burst between its issue and its last record
+struct burst {
+    uint64_t issue_ps = 0;
+    uint64_t first_ps = 0;
+    uint32_t addr = 0;
+    uint32_t bytes = 0;
+    uint32_t lane = 0;    // --lanes: ID track
+    uint32_t ch_lane = 0; // address track, from issue to accept
+    uint32_t data_lane = 0;
+};
+
+class TraceWriter {
+public:
+    explicit TraceWriter (const std::string& path) : out(path) {
+        if (!out) {
+            throw std::runtime_error("cannot create output file: " + path);
+        }
+        out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n";
+    }
+
+    // thread id of a named track of a master, announced on first use
+    uint32_t track (uint32_t master, const std::string& name) {
+        if (masters.insert(master).second) {
+            event();
+            out << "{\"ph\": \"M\", \"name\": \"process_name\", \"pid\": " << master
+                << ", \"args\": {\"name\": \"master " << master << "\"}}";
+            // channels first and in bus order, whatever comes first in the log
+            for (const char* channel : { "AR", "R", "AW", "W", "B" }) {
+                track(master, channel);
+            }
+        }
+        auto key = std::make_pair(master, name);
+        auto it = tracks.find(key);
+        if (it != tracks.end()) {
+            return it->second;
+        }
+        uint32_t tid = static_cast<uint32_t>(tracks.size()) + 1;
+        tracks[key] = tid;
+        event();
+        out << "{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": " << master << ", \"tid\": " << tid
+            << ", \"args\": {\"name\": \"" << name << "\"}}";
+        event();
+        out << "{\"ph\": \"M\", \"name\": \"thread_sort_index\", \"pid\": " << master << ", \"tid\": " << tid
+            << ", \"args\": {\"sort_index\": " << tid << "}}";
+        return tid;
+    }
+
+    void slice (uint32_t master, uint32_t tid, const std::string& name, uint64_t start_ps, uint64_t end_ps, const std::string& args) {
+        event();
+        out << "{\"ph\": \"X\", \"name\": \"" << name << "\", \"pid\": " << master << ", \"tid\": " << tid
+            << ", \"ts\": " << us(start_ps) << ", \"dur\": " << us(end_ps - start_ps) << ", \"args\": {" << args << "}}";
+    }
+
+    void instant (uint32_t master, uint32_t tid, const std::string& name, uint64_t at_ps) {
+        event();
+        out << "{\"ph\": \"i\", \"s\": \"t\", \"name\": \"" << name << "\", \"pid\": " << master << ", \"tid\": " << tid
+            << ", \"ts\": " << us(at_ps) << "}";
+    }
+
+    void finish () {
+        out << "\n]}\n";
+    }
+
+private:
+    std::ofstream out;
+    std::map<std::pair<uint32_t, std::string>, uint32_t> tracks;
+    std::set<uint32_t> masters;
+    bool first = true;
+
+    void event () {
+        out << (first ? "" : ",\n");
+        first = false;
+    }
+
+    // trace event time is µs; ps keeps the fraction exact
+    static std::string us (uint64_t ps) {
+        std::string frac = std::to_string(ps % 1000000);
+        return std::to_string(ps / 1000000) + "." + std::string(6 - frac.size(), '0') + frac;
+    }
+};
+
+// first-free allocation of overlapping slices to numbered tracks
+class Lanes {
+public:
+    uint32_t take () {
+        for (uint32_t l = 0; l < busy.size(); l++) {
+            if (!busy[l]) {
+                busy[l] = true;
+                return l;
+            }
+        }
+        busy.push_back(true);
+        return static_cast<uint32_t>(busy.size() - 1);
+    }
+
+    void give (uint32_t lane) {
+        busy[lane] = false;
+    }
+
+private:
+    std::vector<bool> busy;
+};
+
+static std::vector<TxnRecord> load (const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("cannot open transaction log: " + path);
+    }
+    TxnHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) || std::memcmp(header.magic, "AXITXN\0", 8) != 0) {
+        throw std::runtime_error("not a transaction log: " + path);
+    }
+    if (header.version != 1 || header.record_size != sizeof(TxnRecord)) {
+        throw std::runtime_error("unsupported transaction log version: " + path);
+    }
+    std::vector<TxnRecord> records;
+    TxnRecord rec;
+    while (in.read(reinterpret_cast<char*>(&rec), sizeof(rec))) {
+        if (rec.phase >= TxnRecorder::PHASES) {
+            throw std::runtime_error("corrupt transaction log: " + path);
+        }
+        records.push_back(rec);
+    }
+    // channels arrive chunk by chunk; within one they are already in order
+    std::stable_sort(records.begin(), records.end(), [](const TxnRecord& a, const TxnRecord& b) {
+        return a.time_ps != b.time_ps ? a.time_ps < b.time_ps : a.phase < b.phase;
+    });
+    return records;
+}
+
+static std::string lane_name (const std::string& base, uint32_t lane) {
+    return lane ? base + " #" + std::to_string(lane) : base;
+}
+
+static std::string hex (uint32_t v) {
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "0x%x", v);
+    return buf;
+}
+
+int main (int argc, char* argv[]) {
+    try {
+        std::vector<std::string> paths;
+        bool lanes = false;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--lanes") {
+                lanes = true;
+            } else {
+                paths.push_back(arg);
+            }
+        }
+        if (paths.size() != 2) {
+            std::cerr << "usage: " << argv[0] << " <in.txn> <out.json> [--lanes]" << std::endl;
+            return 1;
+        }
+
+        std::vector<TxnRecord> records = load(paths[0]);
+        TraceWriter out(paths[1]);
+
+        // by master, READ / WRITE, id
+        std::unordered_map<uint64_t, burst> open;
+        std::unordered_map<uint64_t, Lanes> lane_sets; // by master, track family
+        auto lanes_of = [&](uint32_t master, uint32_t family) -> Lanes& {
+            return lane_sets[(static_cast<uint64_t>(master) << 8) | family];
+        };
+        enum family { ADDR_RD, ADDR_WR, DATA_RD, DATA_WR, ID_RD, ID_WR };
+
+        uint64_t bursts = 0;
+        for (const TxnRecord& rec : records) {
+            bool read = rec.phase <= TxnRecorder::R_LAST;
+            uint64_t key = (static_cast<uint64_t>(rec.master) << 33) | (static_cast<uint64_t>(read ? 0 : 1) << 32) | rec.id;
+            const char* kind = read ? "read" : "write";
+
+            if (rec.phase == TxnRecorder::AR_ISSUE || rec.phase == TxnRecorder::AW_ISSUE) {
+                burst& b = open[key];
+                b = burst();
+                b.issue_ps = b.first_ps = rec.time_ps;
+                b.addr = rec.addr;
+                b.bytes = rec.bytes;
+                b.ch_lane = lanes_of(rec.master, read ? ADDR_RD : ADDR_WR).take();
+                if (lanes) {
+                    b.lane = lanes_of(rec.master, read ? ID_RD : ID_WR).take();
+                }
+                continue;
+            }
+            auto it = open.find(key);
+            if (it == open.end()) {
+                continue; // issued before the log started
+            }
+            burst& b = it->second;
+            std::string label = std::string(read ? "AR" : "AW") + " id " + std::to_string(rec.id);
+            std::string args = "\"id\": " + std::to_string(rec.id) + ", \"addr\": \"" + hex(b.addr) + "\", \"bytes\": " + std::to_string(b.bytes);
+
+            switch (rec.phase) {
+            case TxnRecorder::AR_ACCEPT:
+            case TxnRecorder::AW_ACCEPT:
+                out.slice(rec.master, out.track(rec.master, lane_name(read ? "AR" : "AW", b.ch_lane)), label, b.issue_ps, rec.time_ps, args);
+                lanes_of(rec.master, read ? ADDR_RD : ADDR_WR).give(b.ch_lane);
+                break;
+            case TxnRecorder::R_FIRST:
+            case TxnRecorder::W_FIRST:
+                b.first_ps = rec.time_ps;
+                b.data_lane = lanes_of(rec.master, read ? DATA_RD : DATA_WR).take();
+                break;
+            case TxnRecorder::R_LAST:
+            case TxnRecorder::W_LAST:
+                out.slice(rec.master, out.track(rec.master, lane_name(read ? "R" : "W", b.data_lane)),
+                          std::string(read ? "R" : "W") + " id " + std::to_string(rec.id), b.first_ps, rec.time_ps, args);
+                lanes_of(rec.master, read ? DATA_RD : DATA_WR).give(b.data_lane);
+                break;
+            case TxnRecorder::B_RESP:
+                out.instant(rec.master, out.track(rec.master, "B"), "B id " + std::to_string(rec.id), rec.time_ps);
+                break;
+            }
+
+            if (rec.phase == TxnRecorder::R_LAST || rec.phase == TxnRecorder::B_RESP) {
+                std::string track = lanes ? std::string(kind) + " lane " + std::to_string(b.lane)
+                                          : std::string(kind) + " id " + std::to_string(rec.id);
+                out.slice(rec.master, out.track(rec.master, track), std::string(kind) + " " + hex(b.addr),
+                          b.issue_ps, rec.time_ps, args + ", \"latency_ns\": " + std::to_string((rec.time_ps - b.issue_ps) / 1000.0));
+                if (lanes) {
+                    lanes_of(rec.master, read ? ID_RD : ID_WR).give(b.lane);
+                }
+                open.erase(it);
+                bursts++;
+            }
+        }
+        out.finish();
+
+        std::cout << "[txn2json] " << records.size() << " records, " << bursts << " bursts";
+        if (!open.empty()) {
+            std::cout << ", " << open.size() << " still open at the end (left out)";
+        }
+        std::cout << std::endl;
+        return 0;
+    } catch (const std::exception& e) {
+        std::cerr << "txn2json: " << e.what() << std::endl;
+        return 1;
+    }
+}
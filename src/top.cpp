@@ -1,30 +1,205 @@
 #include <systemc>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
 #include "config.hpp"
 
 #include "channels/AXIMaster.hpp"
 #include "channels/AXISlave.hpp"
-#include "config.hpp"
+#include "channels/AXICheckpoint.hpp"
+#include "channels/AXIMasterLT.hpp"
+#include "channels/AXISlaveLT.hpp"
+#include "channels/AXIMasterAT.hpp"
+#include "channels/AXISlaveAT.hpp"
+#include "bus.hpp"
+#include "stats.hpp"
+#include "wave.hpp"
+#include "traffic.hpp"
 
-int sc_main(int argc, char* argv[]) {
-    std::cout << "Starting simulation for project: practice07_bus_system" << std::endl;
+// end-of-run counters, summed over every master and slave in the system
+struct totals {
+    double total_data_received = 0;
+    double total_data_written = 0;
+    double total_read_latency = 0;
+    double total_write_latency = 0;
+    uint64_t read_count = 0;
+    uint64_t write_count = 0;
 
-    config_loader m_config_loader;
-    m_config_loader.load_yaml();
+    template <typename M>
+    void add_master (const M& master_inst) {
+        total_data_received += master_inst.total_data_received;
+        total_read_latency  += master_inst.total_read_latency;
+        total_write_latency += master_inst.total_write_latency;
+        read_count          += master_inst.read_count;
+        write_count         += master_inst.write_count;
+    }
+
+    template <typename S>
+    void add_slave (const S& slave_inst) {
+        total_data_written += slave_inst.total_data_written;
+    }
+};
+
+// bytes per ns is GB/s
+static void report (const totals& t, double exe_time) {
+    std::cout << "total_data_received: " << t.total_data_received << " bytes" << std::endl;
+    std::cout << "throughput: " << t.total_data_received / exe_time << " GB/s" << std::endl;
+    std::cout << "total_data_written: " << t.total_data_written << " bytes" << std::endl;
+    std::cout << "throughput: " << t.total_data_written / exe_time << " GB/s" << std::endl;
+    std::cout << "total_read_latency: " << t.total_read_latency << " ns (" << t.read_count << " bursts)" << std::endl;
+    std::cout << "total_write_latency: " << t.total_write_latency << " ns (" << t.write_count << " bursts)" << std::endl;
+}
+
+template <typename S>
+static void dump_memory (const S& slave_inst, const config& cfg, const std::string& suffix = "") {
+    if (!cfg.memory.dump.empty()) {
+        slave_inst.memory.dump(cfg.memory.dump + suffix, cfg.memory.image_base);
+    }
+}
+
+// hands a signal to the tracer, if tracing is enabled
+template <typename T>
+static void trace (WaveTracer* tracer, const std::string& channel, const sc_core::sc_signal_in_if<T>& signal, const std::string& name) {
+    if (tracer) {
+        tracer->add(channel, name, signal);
+    }
+}
+
+template <typename M, typename S>
+static void report (const M& master_inst, const S& slave_inst, double exe_time) {
+    totals t;
+    t.add_master(master_inst);
+    t.add_slave(slave_inst);
+    report(t, exe_time);
+}
+
+// loosely-timed fast mode: one b_transport per burst, no pins, no waveform
+static int run_lt (const config& cfg) {
+    tlm::tlm_global_quantum::instance().set(sc_core::sc_time(cfg.lt.quantum_ns, sc_core::SC_NS));
 
-    AXIMaster master_inst("master_instance");
-    AXISlave slave_inst("slave_instance");
+    AXIMasterLT master_inst("master_instance", cfg);
+    AXISlaveLT slave_inst("slave_instance", cfg);
+    master_inst.socket.bind(slave_inst.socket);
+    StatsExporter stats_exporter("stats_exporter", cfg);
+    stats_exporter.add("master_instance", master_inst.stats);
+
+    double exe_time = cfg.common.execution_time;
+    sc_core::sc_start(exe_time, sc_core::SC_NS);
+
+    report(master_inst, slave_inst, exe_time);
+    stats_exporter.finish(exe_time);
+    slave_inst.dram_model.report(std::cout);
+    slave_inst.write_buffer.report(std::cout);
+    slave_inst.prefetcher.report(std::cout);
+    dump_memory(slave_inst, cfg);
+    return 0;
+}
+
+// approximately-timed mode: 4-phase nb_transport, many outstanding bursts
+static int run_at (const config& cfg) {
+    AXIMasterAT master_inst("master_instance", cfg);
+    AXISlaveAT slave_inst("slave_instance", cfg);
+    master_inst.rd_socket.bind(slave_inst.rd_socket);
+    master_inst.wr_socket.bind(slave_inst.wr_socket);
+    StatsExporter stats_exporter("stats_exporter", cfg);
+    stats_exporter.add("master_instance", master_inst.stats);
+
+    double exe_time = cfg.common.execution_time;
+    sc_core::sc_start(exe_time, sc_core::SC_NS);
+
+    report(master_inst, slave_inst, exe_time);
+    stats_exporter.finish(exe_time);
+    std::cout << "reorder_count: " << slave_inst.reorder_count << std::endl;
+    slave_inst.dram_model.report(std::cout);
+    slave_inst.write_buffer.report(std::cout);
+    slave_inst.prefetcher.report(std::cout);
+    dump_memory(slave_inst, cfg);
+    return 0;
+}
+
+// bus.masters AT masters and bus.slaves AT slaves behind the crossbar
+static int run_bus (const config& cfg) {
+    std::vector<std::unique_ptr<AXIMasterAT>> masters;
+    std::vector<std::unique_ptr<AXISlaveAT>> slaves;
+    Bus bus_inst("bus_instance", cfg);
+    StatsExporter stats_exporter("stats_exporter", cfg);
+
+    for (uint32_t m = 0; m < cfg.bus.masters; m++) {
+        std::string name = "master_" + std::to_string(m);
+        masters.emplace_back(new AXIMasterAT(name.c_str(), cfg, m));
+        masters.back()->rd_socket.bind(bus_inst.rd_target_socket);
+        masters.back()->wr_socket.bind(bus_inst.wr_target_socket);
+        stats_exporter.add(name, masters.back()->stats);
+    }
+    for (uint32_t s = 0; s < cfg.bus.slaves; s++) {
+        std::string name = "slave_" + std::to_string(s);
+        slaves.emplace_back(new AXISlaveAT(name.c_str(), cfg));
+        bus_inst.rd_init_socket.bind(slaves.back()->rd_socket);
+        bus_inst.wr_init_socket.bind(slaves.back()->wr_socket);
+    }
+
+    double exe_time = cfg.common.execution_time;
+    sc_core::sc_start(exe_time, sc_core::SC_NS);
 
-    sc_core::sc_trace_file* tf = sc_core::sc_create_vcd_trace_file("axi_ar_waveform");
-    if (!tf) {
-        std::cerr << "Error: Could not create trace file!" << std::endl;
+    totals t;
+    for (uint32_t m = 0; m < masters.size(); m++) {
+        const AXIMasterAT& master_inst = *masters[m];
+        std::cout << "[master:" << m << "] received: " << master_inst.total_data_received << " bytes, "
+                  << "avg_read_latency: " << (master_inst.read_count ? master_inst.total_read_latency / master_inst.read_count : 0) << " ns" << std::endl;
+        t.add_master(master_inst);
+    }
+    for (uint32_t s = 0; s < slaves.size(); s++) {
+        t.add_slave(*slaves[s]);
+        slaves[s]->dram_model.report(std::cout);
+        slaves[s]->write_buffer.report(std::cout);
+        slaves[s]->prefetcher.report(std::cout);
+        dump_memory(*slaves[s], cfg, "." + std::to_string(s));
+    }
+    bus_inst.report(std::cout, exe_time);
+    report(t, exe_time);
+    stats_exporter.finish(exe_time);
+    return 0;
+}
+
+// pin-accurate model
+static int run_pin (const config& cfg) {
+    AXIMaster master_inst("master_instance", cfg);
+    AXISlave slave_inst("slave_instance", cfg);
+    std::unique_ptr<AXICheckpoint> checkpoint;
+    double start_ns = cfg.clock.start_delay_ns;
+    if (!cfg.checkpoint.save.empty() || !cfg.checkpoint.restore.empty()) {
+        checkpoint.reset(new AXICheckpoint("checkpoint", cfg, master_inst, slave_inst));
+        if (!cfg.checkpoint.restore.empty()) {
+            start_ns = checkpoint->resume_time();
+        }
+    }
+    if (start_ns >= cfg.common.execution_time) {
+        std::cerr << "Error: checkpoint at " << start_ns << " ns is past common.execution_time" << std::endl;
         return 1;
     }
+    StatsExporter stats_exporter("stats_exporter", cfg);
+    stats_exporter.add("master_instance", master_inst.stats);
+
+    std::unique_ptr<WaveTracer> tracer;
+    if (cfg.trace.enable) {
+        tracer.reset(new WaveTracer("wave_tracer", cfg));
+        tracer->watch(master_inst.stats);
+    }
 
-    sc_core::sc_clock clk("main_clock", m_config_loader.cfg.clock.period_ns, sc_core::SC_NS, 0.5, 5, sc_core::SC_NS, true);
+    std::unique_ptr<CompletionLog> completion_log;
+    if (!cfg.stats.completions.empty()) {
+        completion_log.reset(new CompletionLog(cfg.stats.completions, cfg.clock.start_delay_ns, cfg.clock.period_ns));
+        master_inst.stats.completion_log = completion_log.get();
+    }
+
+    sc_core::sc_clock clk("main_clock", cfg.clock.period_ns, sc_core::SC_NS, 0.5, start_ns, sc_core::SC_NS, true);
     master_inst.clk(clk);
     slave_inst.clk(clk);
-    sc_core::sc_trace(tf, clk, "clk");
+    if (checkpoint) {
+        checkpoint->clk(clk);
+    }
+    trace(tracer.get(), "clk", clk, "clk");
 
     // AR channel
     sc_core::sc_signal<bool> arvalid_signal("arvalid_signal");
@@ -33,6 +208,7 @@ int sc_main(int argc, char* argv[]) {
     sc_core::sc_signal<uint32_t> araddr_signal("araddr_signal");
     sc_core::sc_signal<uint32_t> arsize_signal("arsize_signal");
     sc_core::sc_signal<uint32_t> arlen_signal("arlen_signal");
+    sc_core::sc_signal<uint32_t> arburst_signal("arburst_signal");
     master_inst.arvalid(arvalid_signal);
     slave_inst.arvalid(arvalid_signal);
     master_inst.arready(arready_signal);
@@ -45,18 +221,21 @@ int sc_main(int argc, char* argv[]) {
     slave_inst.arsize(arsize_signal);
     master_inst.arlen(arlen_signal);
     slave_inst.arlen(arlen_signal);
-    sc_core::sc_trace(tf, master_inst.arvalid, "arvalid");
-    sc_core::sc_trace(tf, master_inst.arready, "arready");
-    sc_core::sc_trace(tf, master_inst.arid, "arid");
-    sc_core::sc_trace(tf, master_inst.araddr, "araddr");
-    sc_core::sc_trace(tf, master_inst.arsize, "arsize");
-    sc_core::sc_trace(tf, master_inst.arlen, "arlen");
+    master_inst.arburst(arburst_signal);
+    slave_inst.arburst(arburst_signal);
+    trace(tracer.get(), "ar", arvalid_signal, "arvalid");
+    trace(tracer.get(), "ar", arready_signal, "arready");
+    trace(tracer.get(), "ar", arid_signal, "arid");
+    trace(tracer.get(), "ar", araddr_signal, "araddr");
+    trace(tracer.get(), "ar", arsize_signal, "arsize");
+    trace(tracer.get(), "ar", arlen_signal, "arlen");
+    trace(tracer.get(), "ar", arburst_signal, "arburst");
 
     // R channel
     sc_core::sc_signal<bool> rvalid_signal("rvalid_signal");
     sc_core::sc_signal<bool> rready_signal("rready_signal");
     sc_core::sc_signal<uint32_t> rid_signal("rid_signal");
-    sc_core::sc_signal<uint32_t> rdata_signal("rdata_signal");
+    sc_core::sc_signal<AXIBeat> rdata_signal("rdata_signal");
     sc_core::sc_signal<bool> rlast_signal("rlast_signal");
     master_inst.rvalid(rvalid_signal);
     slave_inst.rvalid(rvalid_signal);
@@ -68,11 +247,11 @@ int sc_main(int argc, char* argv[]) {
     slave_inst.rdata(rdata_signal);
     master_inst.rlast(rlast_signal);
     slave_inst.rlast(rlast_signal);
-    sc_core::sc_trace(tf, master_inst.rvalid, "rvalid");
-    sc_core::sc_trace(tf, master_inst.rready, "rready");
-    sc_core::sc_trace(tf, master_inst.rid, "rid");
-    sc_core::sc_trace(tf, master_inst.rdata, "rdata");
-    sc_core::sc_trace(tf, master_inst.rlast, "rlast");
+    trace(tracer.get(), "r", rvalid_signal, "rvalid");
+    trace(tracer.get(), "r", rready_signal, "rready");
+    trace(tracer.get(), "r", rid_signal, "rid");
+    trace(tracer.get(), "r", rdata_signal, "rdata");
+    trace(tracer.get(), "r", rlast_signal, "rlast");
 
     // AW channel
     sc_core::sc_signal<bool> awvalid_signal("awvalid_signal");
@@ -81,6 +260,7 @@ int sc_main(int argc, char* argv[]) {
     sc_core::sc_signal<uint32_t> awaddr_signal("awaddr_signal");
     sc_core::sc_signal<uint32_t> awsize_signal("awsize_signal");
     sc_core::sc_signal<uint32_t> awlen_signal("awlen_signal");
+    sc_core::sc_signal<uint32_t> awburst_signal("awburst_signal");
     master_inst.awvalid(awvalid_signal);
     slave_inst.awvalid(awvalid_signal);
     master_inst.awready(awready_signal);
@@ -93,18 +273,22 @@ int sc_main(int argc, char* argv[]) {
     slave_inst.awsize(awsize_signal);
     master_inst.awlen(awlen_signal);
     slave_inst.awlen(awlen_signal);
-    sc_core::sc_trace(tf, master_inst.awvalid, "awvalid");
-    sc_core::sc_trace(tf, master_inst.awready, "awready");
-    sc_core::sc_trace(tf, master_inst.awid, "awid");
-    sc_core::sc_trace(tf, master_inst.awaddr, "awaddr");
-    sc_core::sc_trace(tf, master_inst.awsize, "awsize");
-    sc_core::sc_trace(tf, master_inst.awlen, "awlen");
+    master_inst.awburst(awburst_signal);
+    slave_inst.awburst(awburst_signal);
+    trace(tracer.get(), "aw", awvalid_signal, "awvalid");
+    trace(tracer.get(), "aw", awready_signal, "awready");
+    trace(tracer.get(), "aw", awid_signal, "awid");
+    trace(tracer.get(), "aw", awaddr_signal, "awaddr");
+    trace(tracer.get(), "aw", awsize_signal, "awsize");
+    trace(tracer.get(), "aw", awlen_signal, "awlen");
+    trace(tracer.get(), "aw", awburst_signal, "awburst");
 
     // W channel
     sc_core::sc_signal<bool> wvalid_signal("wvalid_signal");
     sc_core::sc_signal<bool> wready_signal("wready_signal");
     sc_core::sc_signal<uint32_t> wid_signal("wid_signal");
-    sc_core::sc_signal<uint32_t> wdata_signal("wdata_signal");
+    sc_core::sc_signal<AXIBeat> wdata_signal("wdata_signal");
+    sc_core::sc_signal<AXIStrobe> wstrb_signal("wstrb_signal");
     sc_core::sc_signal<bool> wlast_signal("wlast_signal");
     master_inst.wvalid(wvalid_signal);
     slave_inst.wvalid(wvalid_signal);
@@ -114,21 +298,103 @@ int sc_main(int argc, char* argv[]) {
     slave_inst.wid(wid_signal);
     master_inst.wdata(wdata_signal);
     slave_inst.wdata(wdata_signal);
+    master_inst.wstrb(wstrb_signal);
+    slave_inst.wstrb(wstrb_signal);
     master_inst.wlast(wlast_signal);
     slave_inst.wlast(wlast_signal);
-    sc_core::sc_trace(tf, master_inst.wvalid, "wvalid");
-    sc_core::sc_trace(tf, master_inst.wready, "wready");
-    sc_core::sc_trace(tf, master_inst.wid, "wid");
-    sc_core::sc_trace(tf, master_inst.wdata, "wdata");
-    sc_core::sc_trace(tf, master_inst.wlast, "wlast");
+    trace(tracer.get(), "w", wvalid_signal, "wvalid");
+    trace(tracer.get(), "w", wready_signal, "wready");
+    trace(tracer.get(), "w", wid_signal, "wid");
+    trace(tracer.get(), "w", wdata_signal, "wdata");
+    trace(tracer.get(), "w", wstrb_signal, "wstrb");
+    trace(tracer.get(), "w", wlast_signal, "wlast");
 
-    double exe_time = m_config_loader.cfg.common.execution_time;
-    sc_core::sc_start(exe_time, sc_core::SC_NS);
+    // B channel
+    sc_core::sc_signal<bool> bvalid_signal("bvalid_signal");
+    sc_core::sc_signal<bool> bready_signal("bready_signal");
+    sc_core::sc_signal<uint32_t> bid_signal("bid_signal");
+    sc_core::sc_signal<uint32_t> bresp_signal("bresp_signal");
+    master_inst.bvalid(bvalid_signal);
+    slave_inst.bvalid(bvalid_signal);
+    master_inst.bready(bready_signal);
+    slave_inst.bready(bready_signal);
+    master_inst.bid(bid_signal);
+    slave_inst.bid(bid_signal);
+    master_inst.bresp(bresp_signal);
+    slave_inst.bresp(bresp_signal);
+    trace(tracer.get(), "b", bvalid_signal, "bvalid");
+    trace(tracer.get(), "b", bready_signal, "bready");
+    trace(tracer.get(), "b", bid_signal, "bid");
+    trace(tracer.get(), "b", bresp_signal, "bresp");
 
-    std::cout << "total_data_received: " << master_inst.total_data_received << " bytes" << std::endl;
-    std::cout << "throughput: " << (((master_inst.total_data_received / 1000000000)) / (exe_time * 0.000000001)) << " GB/s" << std::endl;
-    std::cout << "total_data_written: " << slave_inst.total_data_written << " bytes" << std::endl;
-    std::cout << "throughput: " << (((slave_inst.total_data_written / 1000000000)) / (exe_time * 0.000000001)) << " GB/s" << std::endl;
-    std::cout << "Simulation for project: practice07_bus_system finished." << std::endl;
+    sc_core::sc_start(cfg.common.execution_time, sc_core::SC_NS);
+    // earlier when the run stops at a checkpoint
+    double exe_time = sc_core::sc_time_stamp().to_seconds() * 1e9;
+
+    report(master_inst, slave_inst, exe_time);
+    std::cout << "reorder_count: " << slave_inst.reorder_count << std::endl;
+    if (cfg.slave.read_interleave > 1) {
+        std::cout << "interleaved_beats: " << slave_inst.interleaved_beats << std::endl;
+    }
+    slave_inst.dram_model.report(std::cout);
+    slave_inst.write_buffer.report(std::cout);
+    slave_inst.prefetcher.report(std::cout);
+    dump_memory(slave_inst, cfg);
+    stats_exporter.finish(exe_time);
+    if (tracer) {
+        tracer->finish();
+    }
     return 0;
 }
+
+int sc_main(int argc, char* argv[]) {
+    // trace conversion only, no simulation
+    if (argc == 4 && std::string(argv[1]) == "--import-trace") {
+        TraceSource::import_csv(argv[2], argv[3]);
+        return 0;
+    }
+
+    // _sim [--config <path>] [key=value ...]
+    std::string config_path = "./config.yaml";
+    std::vector<std::string> overrides;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--config" && i + 1 < argc) {
+            config_path = argv[++i];
+        } else if (arg.find('=') != std::string::npos) {
+            overrides.push_back(arg);
+        } else {
+            std::cerr << "usage: " << argv[0] << " [--config <path>] [key=value ...]" << std::endl;
+            std::cerr << "       " << argv[0] << " --import-trace <in.csv> <out.trc>" << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << "Starting simulation for project: practice07_bus_system" << std::endl;
+
+    config_loader m_config_loader;
+    m_config_loader.load_yaml(config_path, overrides);
+    const config& cfg = m_config_loader.cfg;
+
+    if ((!cfg.checkpoint.save.empty() || !cfg.checkpoint.restore.empty()) && cfg.common.model != "pin") {
+        std::cerr << "Error: checkpoint.save / checkpoint.restore need common.model: pin" << std::endl;
+        return 1;
+    }
+
+    int ret;
+    if (cfg.common.model == "lt") {
+        ret = run_lt(cfg);
+    } else if (cfg.common.model == "at") {
+        ret = run_at(cfg);
+    } else if (cfg.common.model == "bus") {
+        ret = run_bus(cfg);
+    } else if (cfg.common.model == "pin") {
+        ret = run_pin(cfg);
+    } else {
+        std::cerr << "Error: unknown common.model '" << cfg.common.model << "'" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Simulation for project: practice07_bus_system finished." << std::endl;
+    return ret;
+}